@@ -0,0 +1,828 @@
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "DurableRBTree.h"
+
+#define FAIL 0
+#define SUCCESS 1
+#define WAL_INSERT 1
+#define WAL_DELETE 2
+#define WAL_HEADER_SIZE 5
+#define CRC_SIZE 4
+#define CHECKPOINT_MAGIC "RBCK"
+#define CHECKPOINT_VERSION 1
+#define CHECKPOINT_HEADER_SIZE 16
+#define CHECKPOINT_FLUSH_SIZE ((size_t) 64 * 1024)
+#define DURABLE_MIN_BUFFER 256
+
+/**
+ * the durable tree: the tree, the log file and the records which wait for a group commit.
+ * the log holds records of (u32 length, u8 operation, length bytes of the item, u32 CRC32 of the
+ * previous fields), all little endian. only operations which succeeded are logged, so every insert
+ * in the log is of an item which was not in the tree and every delete of an item which was. hence
+ * for every item the last record of it in the log tells whether it is in the tree, and replaying the
+ * log on any checkpoint taken after the log began gives the same tree - a crash between renaming a
+ * new checkpoint and truncating the log loses nothing.
+ */
+struct DurableRBTree
+{
+	RBTree *tree;
+	EncodeFunc encode;
+	DecodeFunc decode;
+	DurableConfig config;
+	char *walPath;
+	char *checkpointPath;
+	char *tempPath;
+	int walFd;
+	int failed; // set when the log could not be written, every later change fails.
+	unsigned char *pending;
+	size_t pendingSize;
+	size_t pendingCapacity;
+	long unsigned pendingRecords;
+	long unsigned pendingSince;
+	DurableStats stats;
+};
+
+/**
+ * the state of writing a checkpoint, the arguments of writeCheckpointItem
+ */
+typedef struct CheckpointWriter
+{
+	int fd;
+	EncodeFunc encode;
+	unsigned char *bytes;
+	size_t used;
+	size_t capacity;
+	size_t written;
+	uint32_t crc;
+	int failed;
+} CheckpointWriter;
+
+static uint32_t crcTable[256];
+static pthread_once_t crcOnce = PTHREAD_ONCE_INIT;
+
+/**
+ * fills the table of CRC32 (the reflected polynomial 0xEDB88320)
+ */
+void initCrcTable(void)
+{
+	for(uint32_t i = 0; i < 256; i++)
+	{
+		uint32_t crc = i;
+		for(int bit = 0; bit < 8; bit++)
+		{
+			crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+		}
+		crcTable[i] = crc;
+	}
+}
+
+/**
+ * continues a CRC32 over more bytes
+ * @param crc the CRC of the bytes before, 0 at the beginning
+ * @param bytes the bytes
+ * @param length the number of bytes
+ * @return the CRC of all the bytes
+ */
+uint32_t updateCrc(uint32_t crc, const unsigned char *bytes, size_t length)
+{
+	pthread_once(&crcOnce, initCrcTable);
+	crc = ~crc;
+	for(size_t i = 0; i < length; i++)
+	{
+		crc = crcTable[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+/**
+ * writes a 32 bit number in little endian
+ */
+void putU32(unsigned char *bytes, uint32_t value)
+{
+	for(int i = 0; i < 4; i++)
+	{
+		bytes[i] = (unsigned char) (value >> (8 * i));
+	}
+}
+
+/**
+ * reads a 32 bit number in little endian
+ */
+uint32_t getU32(const unsigned char *bytes)
+{
+	uint32_t value = 0;
+	for(int i = 3; i >= 0; i--)
+	{
+		value = (value << 8) | bytes[i];
+	}
+	return value;
+}
+
+/**
+ * the time of a monotonic clock in microseconds
+ */
+long unsigned nowMicros(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (long unsigned) now.tv_sec * 1000000UL + (long unsigned) now.tv_nsec / 1000;
+}
+
+/**
+ * grows a buffer to hold at least needed bytes
+ * @param bytes pointer to the buffer
+ * @param capacity pointer to the size of the buffer
+ * @param needed the size the buffer must have
+ * @return 0 on failure (the buffer is not changed), 1 on success
+ */
+int reserveBytes(unsigned char **bytes, size_t *capacity, size_t needed)
+{
+	if(needed <= *capacity)
+	{
+		return SUCCESS;
+	}
+	size_t newCapacity = *capacity < DURABLE_MIN_BUFFER ? DURABLE_MIN_BUFFER : *capacity;
+	while(newCapacity < needed)
+	{
+		newCapacity *= 2;
+	}
+	unsigned char* newBytes = (unsigned char *) realloc(*bytes, newCapacity);
+	if(newBytes == NULL)
+	{
+		return FAIL;
+	}
+	*bytes = newBytes;
+	*capacity = newCapacity;
+	return SUCCESS;
+}
+
+/**
+ * encodes an item at the end of a buffer, after a gap of header bytes and before a gap of trailer
+ * bytes, growing the buffer as needed
+ * @param encode the function to encode the item
+ * @param item the item
+ * @param bytes pointer to the buffer
+ * @param capacity pointer to the size of the buffer
+ * @param used the bytes of the buffer in use
+ * @param header the bytes to leave before the item
+ * @param trailer the bytes to leave after the item
+ * @param length where to write the length of the item
+ * @return 0 on failure, 1 on success
+ */
+int encodeItem(EncodeFunc encode, const void *item, unsigned char **bytes, size_t *capacity, size_t used,
+			   size_t header, size_t trailer, size_t *length)
+{
+	if(reserveBytes(bytes, capacity, used + header + trailer) == 0)
+	{
+		return FAIL;
+	}
+	size_t room = *capacity - used - header - trailer;
+	*length = encode(item, *bytes + used + header, room);
+	if(*length <= room)
+	{
+		return *length <= UINT32_MAX;
+	}
+	if(*length > UINT32_MAX || reserveBytes(bytes, capacity, used + header + *length + trailer) == 0)
+	{
+		return FAIL;
+	}
+	room = *capacity - used - header - trailer;
+	return encode(item, *bytes + used + header, room) == *length;
+}
+
+/**
+ * writes all the bytes to a file, continuing after partial writes
+ * @param fd the file
+ * @param bytes the bytes
+ * @param length the number of bytes
+ * @return 0 on failure, 1 on success
+ */
+int writeAll(int fd, const unsigned char *bytes, size_t length)
+{
+	while(length > 0)
+	{
+		ssize_t written = write(fd, bytes, length);
+		if(written < 0)
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+			return FAIL;
+		}
+		bytes += written;
+		length -= (size_t) written;
+	}
+	return SUCCESS;
+}
+
+/**
+ * reads a whole file to memory
+ * @param fd the file
+ * @param length where to write the size of the file
+ * @return the bytes of the file (freed with free), NULL on failure or if the file is empty
+ */
+unsigned char *readAll(int fd, size_t *length)
+{
+	*length = 0;
+	struct stat info;
+	if(fstat(fd, &info) != 0 || info.st_size <= 0)
+	{
+		return NULL;
+	}
+	unsigned char* bytes = (unsigned char *) malloc((size_t) info.st_size);
+	if(bytes == NULL)
+	{
+		return NULL;
+	}
+	size_t done = 0;
+	while(done < (size_t) info.st_size)
+	{
+		ssize_t got = pread(fd, bytes + done, (size_t) info.st_size - done, (off_t) done);
+		if(got < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if(got <= 0)
+		{
+			free(bytes);
+			return NULL;
+		}
+		done += (size_t) got;
+	}
+	*length = done;
+	return bytes;
+}
+
+/**
+ * fsyncs the directory of a path, so a rename in it survives a crash
+ * @param path the path of a file in the directory
+ * @return 0 on failure, 1 on success
+ */
+int syncDirectory(const char *path)
+{
+	const char* slash = strrchr(path, '/');
+	char* directory = NULL;
+	if(slash == NULL)
+	{
+		directory = strdup(".");
+	}
+	else
+	{
+		size_t length = slash == path ? 1 : (size_t) (slash - path);
+		directory = strndup(path, length);
+	}
+	if(directory == NULL)
+	{
+		return FAIL;
+	}
+	int fd = open(directory, O_RDONLY);
+	free(directory);
+	if(fd < 0)
+	{
+		return FAIL;
+	}
+	int result = fsync(fd) == 0;
+	close(fd);
+	return result;
+}
+
+/**
+ * joins a path and an extension
+ * @return the new string (freed with free), NULL on failure
+ */
+char *joinPath(const char *path, const char *extension)
+{
+	size_t pathLength = strlen(path), extensionLength = strlen(extension);
+	char* joined = (char *) malloc(pathLength + extensionLength + 1);
+	if(joined != NULL)
+	{
+		memcpy(joined, path, pathLength);
+		memcpy(joined + pathLength, extension, extensionLength + 1);
+	}
+	return joined;
+}
+
+/**
+ * EncodeFunc for strings.
+ */
+size_t encodeString(const void *item, unsigned char *buffer, size_t capacity)
+{
+	size_t length = strlen((const char *) item);
+	if(length <= capacity)
+	{
+		memcpy(buffer, item, length);
+	}
+	return length;
+}
+
+/**
+ * DecodeFunc for strings, the strings are allocated with malloc (freed with freeString).
+ */
+void *decodeString(const unsigned char *bytes, size_t length)
+{
+	char* string = (char *) malloc(length + 1);
+	if(string != NULL)
+	{
+		memcpy(string, bytes, length);
+		string[length] = '\0';
+	}
+	return string;
+}
+
+/**
+ * loads the checkpoint of a durable tree to its empty tree
+ * @param durable the durable tree
+ * @return 0 on failure (a corrupt checkpoint), 1 on success (also when there is no checkpoint)
+ */
+int loadCheckpoint(DurableRBTree *durable)
+{
+	int fd = open(durable->checkpointPath, O_RDONLY);
+	if(fd < 0)
+	{
+		return errno == ENOENT;
+	}
+	size_t length = 0;
+	unsigned char* bytes = readAll(fd, &length);
+	close(fd);
+	if(bytes == NULL || length < CHECKPOINT_HEADER_SIZE + CRC_SIZE ||
+		memcmp(bytes, CHECKPOINT_MAGIC, 4) != 0 || getU32(bytes + 4) != CHECKPOINT_VERSION ||
+		updateCrc(0, bytes, length - CRC_SIZE) != getU32(bytes + length - CRC_SIZE))
+	{
+		free(bytes);
+		return FAIL;
+	}
+	uint64_t count = (uint64_t) getU32(bytes + 8) | (uint64_t) getU32(bytes + 12) << 32;
+	size_t end = length - CRC_SIZE;
+	if(count > (end - CHECKPOINT_HEADER_SIZE) / 4)
+	{
+		free(bytes);
+		return FAIL;
+	}
+	void** items = (void **) malloc(sizeof(void *) * (count > 0 ? count : 1));
+	if(items == NULL)
+	{
+		free(bytes);
+		return FAIL;
+	}
+	size_t offset = CHECKPOINT_HEADER_SIZE;
+	long unsigned decoded = 0;
+	int result = SUCCESS;
+	while(decoded < count)
+	{
+		if(end - offset < 4 || end - offset - 4 < getU32(bytes + offset))
+		{
+			result = FAIL;
+			break;
+		}
+		size_t itemLength = getU32(bytes + offset);
+		items[decoded] = durable->decode(bytes + offset + 4, itemLength);
+		if(items[decoded] == NULL)
+		{
+			result = FAIL;
+			break;
+		}
+		decoded++;
+		offset += 4 + itemLength;
+	}
+	free(bytes);
+	if(result == SUCCESS && offset == end && RBTreeBulkLoad(durable->tree, items, decoded) != 0)
+	{
+		durable->stats.loadedItems = decoded;
+		free(items);
+		return SUCCESS;
+	}
+	for(long unsigned i = 0; i < decoded && durable->tree->freeFunc != NULL; i++)
+	{
+		durable->tree->freeFunc(items[i]);
+	}
+	free(items);
+	return FAIL;
+}
+
+/**
+ * replays the log of a durable tree on its tree, and cuts a torn or corrupt record at the end of
+ * the log (the write of which did not finish before a crash) with all that follows it
+ * @param durable the durable tree
+ * @return 0 on failure, 1 on success
+ */
+int replayLog(DurableRBTree *durable)
+{
+	size_t length = 0;
+	unsigned char* bytes = readAll(durable->walFd, &length);
+	if(bytes == NULL)
+	{
+		struct stat info;
+		if(fstat(durable->walFd, &info) != 0 || info.st_size > 0)
+		{
+			return FAIL;
+		}
+		return SUCCESS;
+	}
+	size_t offset = 0;
+	int result = SUCCESS;
+	while(length - offset >= WAL_HEADER_SIZE + CRC_SIZE)
+	{
+		size_t itemLength = getU32(bytes + offset);
+		unsigned char op = bytes[offset + 4];
+		if(length - offset - WAL_HEADER_SIZE - CRC_SIZE < itemLength ||
+			updateCrc(0, bytes + offset, WAL_HEADER_SIZE + itemLength) !=
+			getU32(bytes + offset + WAL_HEADER_SIZE + itemLength) || (op != WAL_INSERT && op != WAL_DELETE))
+		{
+			break;
+		}
+		void* item = durable->decode(bytes + offset + WAL_HEADER_SIZE, itemLength);
+		if(item == NULL)
+		{
+			result = FAIL;
+			break;
+		}
+		if(op == WAL_INSERT && RBTreeContains(durable->tree, item) == 0)
+		{
+			if(insertToRBTree(durable->tree, item) == 0)
+			{
+				if(durable->tree->freeFunc != NULL)
+				{
+					durable->tree->freeFunc(item);
+				}
+				result = FAIL;
+				break;
+			}
+		}
+		else
+		{
+			// an insert of an item in the tree or a delete of an item which is not, after a checkpoint.
+			if(op == WAL_DELETE)
+			{
+				deleteFromRBTree(durable->tree, item);
+			}
+			if(durable->tree->freeFunc != NULL)
+			{
+				durable->tree->freeFunc(item);
+			}
+		}
+		offset += WAL_HEADER_SIZE + itemLength + CRC_SIZE;
+		durable->stats.replayedRecords++;
+	}
+	free(bytes);
+	if(result == SUCCESS && offset < length &&
+		(ftruncate(durable->walFd, (off_t) offset) != 0 || fsync(durable->walFd) != 0))
+	{
+		result = FAIL;
+	}
+	durable->stats.loggedRecords = durable->stats.replayedRecords;
+	durable->stats.logBytes = offset;
+	return result;
+}
+
+/**
+ * frees a durable tree without syncing it
+ * @param durable the durable tree
+ */
+void freeDurableRBTree(DurableRBTree *durable)
+{
+	if(durable->walFd >= 0)
+	{
+		close(durable->walFd);
+	}
+	freeRBTree(&durable->tree);
+	free(durable->walPath);
+	free(durable->checkpointPath);
+	free(durable->tempPath);
+	free(durable->pending);
+	free(durable);
+}
+
+/**
+ * opens a durable tree, recovering its items from the files of path if they exist.
+ * @param path: the path of the files of the tree, without the extensions.
+ * @param compFunc: a function to compare two items.
+ * @param freeFunc: a function to free an item.
+ * @param encode: a function to serialize an item.
+ * @param decode: a function to deserialize an item.
+ * @param config: when to sync and checkpoint, NULL to sync every operation and never checkpoint by
+ * itself.
+ * @return: pointer to the tree, NULL on failure (e.g. a corrupt checkpoint).
+ */
+DurableRBTree *openDurableRBTree(const char *path, CompareFunc compFunc, FreeFunc freeFunc, EncodeFunc encode,
+								 DecodeFunc decode, const DurableConfig *config)
+{
+	if(path == NULL || compFunc == NULL || encode == NULL || decode == NULL)
+	{
+		return NULL;
+	}
+	long unsigned start = nowMicros();
+	DurableRBTree* durable = (DurableRBTree *) calloc(1, sizeof(DurableRBTree));
+	if(durable == NULL)
+	{
+		return NULL;
+	}
+	durable->walFd = -1;
+	durable->encode = encode;
+	durable->decode = decode;
+	if(config != NULL)
+	{
+		durable->config = *config;
+	}
+	else
+	{
+		durable->config.groupCommitRecords = 1;
+	}
+	durable->tree = newRBTree(compFunc, freeFunc);
+	durable->walPath = joinPath(path, ".wal");
+	durable->checkpointPath = joinPath(path, ".ckpt");
+	durable->tempPath = joinPath(path, ".ckpt.tmp");
+	if(durable->tree == NULL || durable->walPath == NULL || durable->checkpointPath == NULL ||
+		durable->tempPath == NULL)
+	{
+		freeDurableRBTree(durable);
+		return NULL;
+	}
+	unlink(durable->tempPath);
+	durable->walFd = open(durable->walPath, O_RDWR | O_CREAT | O_APPEND, 0644);
+	if(durable->walFd < 0 || loadCheckpoint(durable) == 0 || replayLog(durable) == 0)
+	{
+		freeDurableRBTree(durable);
+		return NULL;
+	}
+	durable->stats.recoveryMicros = nowMicros() - start;
+	return durable;
+}
+
+/**
+ * get the tree itself, to search it and walk it. it must be changed only through the functions of
+ * the durable tree.
+ * @param durable: the durable tree.
+ * @return: the tree, NULL on failure.
+ */
+const RBTree *getDurableTree(const DurableRBTree *durable)
+{
+	if(durable == NULL)
+	{
+		return NULL;
+	}
+	return durable->tree;
+}
+
+/**
+ * write and fsync the operations waiting for a group commit.
+ * @param durable: the tree.
+ * @return: 0 on failure, other on success.
+ */
+int syncDurableRBTree(DurableRBTree *durable)
+{
+	if(durable == NULL || durable->failed)
+	{
+		return FAIL;
+	}
+	if(durable->pendingRecords == 0)
+	{
+		return SUCCESS;
+	}
+	long unsigned start = nowMicros();
+	if(writeAll(durable->walFd, durable->pending, durable->pendingSize) == 0 || fsync(durable->walFd) != 0)
+	{
+		durable->failed = 1;
+		return FAIL;
+	}
+	durable->stats.syncs++;
+	durable->stats.syncMicros += nowMicros() - start;
+	durable->stats.logBytes += durable->pendingSize;
+	durable->pendingSize = 0;
+	durable->pendingRecords = 0;
+	return SUCCESS;
+}
+
+/**
+ * adds the bytes of an item to a checkpoint (forEachFunc)
+ * @param object the item
+ * @param args the CheckpointWriter
+ * @return 0 on failure, 1 on success
+ */
+int writeCheckpointItem(const void *object, void *args)
+{
+	CheckpointWriter* writer = (CheckpointWriter *) args;
+	size_t length = 0;
+	if(encodeItem(writer->encode, object, &writer->bytes, &writer->capacity, writer->used, 4, 0, &length) == 0)
+	{
+		writer->failed = 1;
+		return FAIL;
+	}
+	putU32(writer->bytes + writer->used, (uint32_t) length);
+	writer->used += 4 + length;
+	if(writer->used >= CHECKPOINT_FLUSH_SIZE)
+	{
+		writer->crc = updateCrc(writer->crc, writer->bytes, writer->used);
+		if(writeAll(writer->fd, writer->bytes, writer->used) == 0)
+		{
+			writer->failed = 1;
+			return FAIL;
+		}
+		writer->written += writer->used;
+		writer->used = 0;
+	}
+	return SUCCESS;
+}
+
+/**
+ * writes all the items of a durable tree to a new file
+ * @param durable the durable tree
+ * @param fd the file
+ * @param written where to write the size of the file
+ * @return 0 on failure, 1 on success
+ */
+int writeCheckpoint(DurableRBTree *durable, int fd, size_t *written)
+{
+	CheckpointWriter writer = {fd, durable->encode, NULL, 0, 0, 0, 0, 0};
+	if(reserveBytes(&writer.bytes, &writer.capacity, CHECKPOINT_FLUSH_SIZE) == 0)
+	{
+		return FAIL;
+	}
+	uint64_t count = durable->tree->size;
+	memcpy(writer.bytes, CHECKPOINT_MAGIC, 4);
+	putU32(writer.bytes + 4, CHECKPOINT_VERSION);
+	putU32(writer.bytes + 8, (uint32_t) count);
+	putU32(writer.bytes + 12, (uint32_t) (count >> 32));
+	writer.used = CHECKPOINT_HEADER_SIZE;
+	forEachRBTree(durable->tree, writeCheckpointItem, &writer);
+	int result = FAIL;
+	if(!writer.failed && reserveBytes(&writer.bytes, &writer.capacity, writer.used + CRC_SIZE) != 0)
+	{
+		writer.crc = updateCrc(writer.crc, writer.bytes, writer.used);
+		putU32(writer.bytes + writer.used, writer.crc);
+		writer.used += CRC_SIZE;
+		if(writeAll(fd, writer.bytes, writer.used) != 0 && fsync(fd) == 0)
+		{
+			*written = writer.written + writer.used;
+			result = SUCCESS;
+		}
+	}
+	free(writer.bytes);
+	return result;
+}
+
+/**
+ * write all the items to a new checkpoint (atomically replacing the old one) and start the log over.
+ * @param durable: the tree.
+ * @return: 0 on failure, other on success.
+ */
+int checkpointDurableRBTree(DurableRBTree *durable)
+{
+	if(syncDurableRBTree(durable) == 0)
+	{
+		return FAIL;
+	}
+	long unsigned start = nowMicros();
+	int fd = open(durable->tempPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(fd < 0)
+	{
+		return FAIL;
+	}
+	size_t written = 0;
+	int result = writeCheckpoint(durable, fd, &written);
+	if(close(fd) != 0)
+	{
+		result = FAIL;
+	}
+	// the log is cut only after the new checkpoint is durable, until then it is replayed on either.
+	if(result == 0 || rename(durable->tempPath, durable->checkpointPath) != 0 ||
+		syncDirectory(durable->checkpointPath) == 0)
+	{
+		unlink(durable->tempPath);
+		return FAIL;
+	}
+	if(ftruncate(durable->walFd, 0) != 0 || fsync(durable->walFd) != 0)
+	{
+		return FAIL;
+	}
+	durable->stats.checkpoints++;
+	durable->stats.checkpointBytes = written;
+	durable->stats.checkpointMicros = nowMicros() - start;
+	durable->stats.loggedRecords = 0;
+	durable->stats.logBytes = 0;
+	return SUCCESS;
+}
+
+/**
+ * applies an operation to the tree of a durable tree and logs it. the record is added to the
+ * waiting records before the operation, so an operation which fails leaves no record and the tree
+ * never has an operation which cannot be logged.
+ * @param durable the durable tree
+ * @param data the item
+ * @param op WAL_INSERT or WAL_DELETE
+ * @return 0 on failure, 1 on success
+ */
+int logOperation(DurableRBTree *durable, void *data, unsigned char op)
+{
+	if(durable == NULL || data == NULL || durable->failed ||
+		(RBTreeContains(durable->tree, data) != 0) != (op == WAL_DELETE))
+	{
+		return FAIL;
+	}
+	size_t length = 0;
+	size_t offset = durable->pendingSize;
+	if(encodeItem(durable->encode, data, &durable->pending, &durable->pendingCapacity, offset,
+				  WAL_HEADER_SIZE, CRC_SIZE, &length) == 0)
+	{
+		return FAIL;
+	}
+	unsigned char* record = durable->pending + offset;
+	putU32(record, (uint32_t) length);
+	record[4] = op;
+	putU32(record + WAL_HEADER_SIZE + length, updateCrc(0, record, WAL_HEADER_SIZE + length));
+	int applied = op == WAL_INSERT ? insertToRBTree(durable->tree, data) : deleteFromRBTree(durable->tree, data);
+	if(applied == 0)
+	{
+		return FAIL;
+	}
+	durable->pendingSize += WAL_HEADER_SIZE + length + CRC_SIZE;
+	if(durable->pendingRecords == 0)
+	{
+		durable->pendingSince = nowMicros();
+	}
+	durable->pendingRecords++;
+	durable->stats.loggedRecords++;
+	DurableConfig* config = &durable->config;
+	if((config->groupCommitRecords > 0 && durable->pendingRecords >= config->groupCommitRecords) ||
+		(config->groupCommitBytes > 0 && durable->pendingSize >= config->groupCommitBytes) ||
+		(config->groupCommitMicros > 0 && nowMicros() - durable->pendingSince >= config->groupCommitMicros))
+	{
+		if(syncDurableRBTree(durable) == 0)
+		{
+			return FAIL;
+		}
+	}
+	if(config->checkpointRecords > 0 && durable->stats.loggedRecords >= config->checkpointRecords)
+	{
+		// a failed checkpoint leaves the log as it was, so it is only retried on the next operation.
+		checkpointDurableRBTree(durable);
+	}
+	return !durable->failed;
+}
+
+/**
+ * add an item to the tree and log it.
+ * @param durable: the tree to add an item to.
+ * @param data: item to add to the tree.
+ * @return: 0 on failure, other on success. (if the item is already in the tree - failure. if the
+ * log could not be written, the item is in the tree but not durable, and this and every later
+ * operation fail).
+ */
+int insertToDurableRBTree(DurableRBTree *durable, void *data)
+{
+	return logOperation(durable, data, WAL_INSERT);
+}
+
+/**
+ * remove an item from the tree and log it.
+ * @param durable: the tree to remove an item from.
+ * @param data: item to remove from the tree.
+ * @return: 0 on failure, other on success. (same as insertToDurableRBTree).
+ */
+int deleteFromDurableRBTree(DurableRBTree *durable, void *data)
+{
+	return logOperation(durable, data, WAL_DELETE);
+}
+
+/**
+ * get what the durability layer did.
+ * @param durable: the tree.
+ * @param stats: where to write the statistics.
+ * @return: 0 on failure, other on success.
+ */
+int getDurableStats(const DurableRBTree *durable, DurableStats *stats)
+{
+	if(durable == NULL || stats == NULL)
+	{
+		return FAIL;
+	}
+	*stats = durable->stats;
+	stats->logBytes += durable->pendingSize;
+	return SUCCESS;
+}
+
+/**
+ * sync the waiting operations, close the files and free all memory of the tree.
+ * @param durable: pointer to the tree to close.
+ * @return: 0 if the waiting operations could not be synced, other on success.
+ */
+int closeDurableRBTree(DurableRBTree **durable)
+{
+	int result = SUCCESS;
+	if(*durable != NULL)
+	{
+		result = syncDurableRBTree(*durable);
+		freeDurableRBTree(*durable);
+	}
+	*durable = NULL;
+	return result;
+}
@@ -0,0 +1,142 @@
+#ifndef RBTREE_DURABLERBTREE_H
+#define RBTREE_DURABLERBTREE_H
+
+#include "RBTree.h"
+
+/**
+ * a function to serialize an item.
+ * @item: the item.
+ * @buffer: where to write the bytes of the item.
+ * @capacity: the size of buffer, nothing is written if the item needs more.
+ * @return: the number of bytes the item needs.
+ */
+typedef size_t (*EncodeFunc)(const void *item, unsigned char *buffer, size_t capacity);
+
+/**
+ * a function to deserialize an item.
+ * @bytes: the bytes written by the matching EncodeFunc.
+ * @length: the number of bytes.
+ * @return: a new item (freed with the FreeFunc of the tree), NULL on failure.
+ */
+typedef void *(*DecodeFunc)(const unsigned char *bytes, size_t length);
+
+/**
+ * when the log is written to the disk and when the tree is checkpointed. the log is written and
+ * fsynced when any of the group commit limits is reached (a limit of 0 is not used), so several
+ * operations share one fsync. the limits are checked on every operation (there is no background
+ * thread), and the operations since the last sync are lost on a crash.
+ */
+typedef struct DurableConfig
+{
+	long unsigned groupCommitRecords; // sync after this many operations, 1 to sync every operation.
+	size_t groupCommitBytes; // sync when this many bytes of operations wait.
+	long unsigned groupCommitMicros; // sync when the oldest waiting operation is this old.
+	long unsigned checkpointRecords; // checkpoint after this many logged operations, bounding the replay on open.
+} DurableConfig;
+
+/**
+ * what the durability layer did, to tune the configuration.
+ */
+typedef struct DurableStats
+{
+	long unsigned loggedRecords; // the operations in the log since the last checkpoint.
+	size_t logBytes; // the size of the log.
+	long unsigned syncs; // the writes and fsyncs of the log.
+	long unsigned syncMicros; // the time of all the syncs.
+	long unsigned checkpoints; // the checkpoints since the tree was opened.
+	size_t checkpointBytes; // the size of the last checkpoint.
+	long unsigned checkpointMicros; // the time of the last checkpoint.
+	long unsigned loadedItems; // the items loaded from the checkpoint on open.
+	long unsigned replayedRecords; // the operations replayed from the log on open.
+	long unsigned recoveryMicros; // the time of loading and replaying on open.
+} DurableStats;
+
+/**
+ * a tree whose changes survive a crash. every insert and delete is appended to a write ahead log
+ * (<path>.wal) before it is acknowledged as durable, and checkpoints write all the items in order
+ * to <path>.ckpt, after which the log starts over. opening the tree loads the checkpoint with
+ * RBTreeBulkLoad and replays the log, dropping a torn record at its end.
+ * the tree is a set (not counted, not a map), and is not thread safe.
+ */
+typedef struct DurableRBTree DurableRBTree;
+
+/**
+ * EncodeFunc for strings.
+ */
+size_t encodeString(const void *item, unsigned char *buffer, size_t capacity);
+
+/**
+ * DecodeFunc for strings, the strings are allocated with malloc (freed with freeString).
+ */
+void *decodeString(const unsigned char *bytes, size_t length);
+
+/**
+ * opens a durable tree, recovering its items from the files of path if they exist.
+ * @param path: the path of the files of the tree, without the extensions.
+ * @param compFunc: a function to compare two items.
+ * @param freeFunc: a function to free an item.
+ * @param encode: a function to serialize an item.
+ * @param decode: a function to deserialize an item.
+ * @param config: when to sync and checkpoint, NULL to sync every operation and never checkpoint by
+ * itself.
+ * @return: pointer to the tree, NULL on failure (e.g. a corrupt checkpoint).
+ */
+DurableRBTree *openDurableRBTree(const char *path, CompareFunc compFunc, FreeFunc freeFunc, EncodeFunc encode,
+								 DecodeFunc decode, const DurableConfig *config);
+
+/**
+ * get the tree itself, to search it and walk it. it must be changed only through the functions of
+ * the durable tree.
+ * @param durable: the durable tree.
+ * @return: the tree, NULL on failure.
+ */
+const RBTree *getDurableTree(const DurableRBTree *durable);
+
+/**
+ * add an item to the tree and log it.
+ * @param durable: the tree to add an item to.
+ * @param data: item to add to the tree.
+ * @return: 0 on failure, other on success. (if the item is already in the tree - failure. if the
+ * log could not be written, the item is in the tree but not durable, and this and every later
+ * operation fail).
+ */
+int insertToDurableRBTree(DurableRBTree *durable, void *data);
+
+/**
+ * remove an item from the tree and log it.
+ * @param durable: the tree to remove an item from.
+ * @param data: item to remove from the tree.
+ * @return: 0 on failure, other on success. (same as insertToDurableRBTree).
+ */
+int deleteFromDurableRBTree(DurableRBTree *durable, void *data);
+
+/**
+ * write and fsync the operations waiting for a group commit.
+ * @param durable: the tree.
+ * @return: 0 on failure, other on success.
+ */
+int syncDurableRBTree(DurableRBTree *durable);
+
+/**
+ * write all the items to a new checkpoint (atomically replacing the old one) and start the log over.
+ * @param durable: the tree.
+ * @return: 0 on failure, other on success.
+ */
+int checkpointDurableRBTree(DurableRBTree *durable);
+
+/**
+ * get what the durability layer did.
+ * @param durable: the tree.
+ * @param stats: where to write the statistics.
+ * @return: 0 on failure, other on success.
+ */
+int getDurableStats(const DurableRBTree *durable, DurableStats *stats);
+
+/**
+ * sync the waiting operations, close the files and free all memory of the tree.
+ * @param durable: pointer to the tree to close.
+ * @return: 0 if the waiting operations could not be synced, other on success.
+ */
+int closeDurableRBTree(DurableRBTree **durable);
+
+#endif //RBTREE_DURABLERBTREE_H
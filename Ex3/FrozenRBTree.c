@@ -0,0 +1,244 @@
+#include <stdlib.h>
+#include "FrozenRBTree.h"
+
+#define FAIL 0
+#define SUCCESS 1
+#define ITEMS_PER_LINE 8
+
+#if defined(__GNUC__)
+#define PREFETCH(address) __builtin_prefetch(address)
+#else
+#define PREFETCH(address) ((void) (address))
+#endif
+
+/**
+ * the arguments of collectItem
+ */
+typedef struct Collector
+{
+	const void **sorted;
+	long unsigned count;
+} Collector;
+
+/**
+ * ForEach function that appends the item to the sorted array of the collector
+ * @param object the item
+ * @param args pointer to the collector
+ * @return 1 (always succeeds, the array is large enough)
+ */
+int collectItem(const void *object, void *args)
+{
+	Collector* collector = (Collector *) args;
+	collector->sorted[collector->count] = object;
+	collector->count++;
+	return SUCCESS;
+}
+
+/**
+ * places the sorted items in Eytzinger order by an in order walk on the implicit tree
+ * @param frozen the snapshot
+ * @param sorted the items in an ascending order
+ * @param next the index of the next sorted item to place
+ * @param k the current index in the Eytzinger array
+ */
+void placeItems(FrozenRBTree *frozen, const void **sorted, long unsigned *next, long unsigned k)
+{
+	if(k > frozen->size)
+	{
+		return;
+	}
+	placeItems(frozen, sorted, next, 2 * k);
+	frozen->items[k] = sorted[*next];
+	(*next)++;
+	placeItems(frozen, sorted, next, 2 * k + 1);
+}
+
+/**
+ * rebuilds a snapshot from the current items of the tree in O(n), reusing its memory when possible.
+ * @param frozen: the snapshot to rebuild.
+ * @param tree: the tree to take the snapshot of.
+ * @return: 0 on failure (the snapshot is left empty), other on success.
+ */
+int refreezeRBTree(FrozenRBTree *frozen, const RBTree *tree)
+{
+	if(frozen == NULL || tree == NULL)
+	{
+		return FAIL;
+	}
+	frozen->size = 0;
+	frozen->compFunc = tree->compFunc;
+	if(tree->size + 1 > frozen->capacity)
+	{
+		const void **items = (const void **) realloc(frozen->items, sizeof(void *) * (tree->size + 1));
+		if(items == NULL)
+		{
+			return FAIL;
+		}
+		frozen->items = items;
+		frozen->capacity = tree->size + 1;
+	}
+	if(tree->size == 0)
+	{
+		return SUCCESS;
+	}
+	Collector collector;
+	collector.sorted = (const void **) malloc(sizeof(void *) * tree->size);
+	collector.count = 0;
+	if(collector.sorted == NULL)
+	{
+		return FAIL;
+	}
+	forEachRBTree(tree, collectItem, &collector);
+	frozen->size = collector.count;
+	long unsigned next = 0;
+	placeItems(frozen, collector.sorted, &next, 1);
+	free(collector.sorted);
+	return SUCCESS;
+}
+
+/**
+ * builds a read only snapshot of the tree in O(n).
+ * @param tree: the tree to take the snapshot of.
+ * @return: pointer to the new snapshot, NULL on failure.
+ */
+FrozenRBTree *RBTreeFreeze(const RBTree *tree)
+{
+	if(tree == NULL)
+	{
+		return NULL;
+	}
+	FrozenRBTree* frozen = (FrozenRBTree *) malloc(sizeof(FrozenRBTree));
+	if(frozen == NULL)
+	{
+		return NULL;
+	}
+	frozen->items = NULL;
+	frozen->size = 0;
+	frozen->capacity = 0;
+	if(refreezeRBTree(frozen, tree) == FAIL)
+	{
+		freeFrozenRBTree(&frozen);
+		return NULL;
+	}
+	return frozen;
+}
+
+/**
+ * finds the index of the smallest item which is not lower than data. the descent has no branch on
+ * the comparison result, and the items three levels below are prefetched on the way (while they
+ * are in the array).
+ * @param frozen the snapshot
+ * @param data the item to compare to
+ * @return the index of the found item, 0 if all the items are lower than data
+ */
+long unsigned lowerBoundIndex(const FrozenRBTree *frozen, const void *data)
+{
+	long unsigned k = 1;
+	while(k <= frozen->size)
+	{
+		// prefetch only inside the array: even an unused pointer past its end is undefined.
+		if(ITEMS_PER_LINE * k <= frozen->size)
+		{
+			PREFETCH(frozen->items + ITEMS_PER_LINE * k);
+		}
+		k = 2 * k + (frozen->compFunc(frozen->items[k], data) < 0);
+	}
+	// the last turn to the left is the answer: drop the trailing right turns and that left turn.
+	while((k & 1) == 1)
+	{
+		k >>= 1;
+	}
+	return k >> 1;
+}
+
+/**
+ * check whether the snapshot contains this item.
+ * @param frozen: the snapshot to search in.
+ * @param data: item to check.
+ * @return: 0 if the item is not in the snapshot, other if it is.
+ */
+int frozenRBTreeContains(const FrozenRBTree *frozen, const void *data)
+{
+	if(frozen == NULL || data == NULL)
+	{
+		return FAIL;
+	}
+	long unsigned k = lowerBoundIndex(frozen, data);
+	if(k == 0 || frozen->compFunc(frozen->items[k], data) != 0)
+	{
+		return FAIL;
+	}
+	return SUCCESS;
+}
+
+/**
+ * finds the smallest item of the snapshot which is not lower than data.
+ * @param frozen: the snapshot to search in.
+ * @param data: the item to compare to.
+ * @return: the found item, NULL if all the items are lower than data.
+ */
+const void *frozenRBTreeLowerBound(const FrozenRBTree *frozen, const void *data)
+{
+	if(frozen == NULL || data == NULL)
+	{
+		return NULL;
+	}
+	long unsigned k = lowerBoundIndex(frozen, data);
+	if(k == 0)
+	{
+		return NULL;
+	}
+	return frozen->items[k];
+}
+
+/**
+ * in order walk on the implicit tree
+ * @param frozen the snapshot
+ * @param k the current index
+ * @param func the func to apply on the items
+ * @param args extra args
+ * @return 0 if the func failed, else 1
+ */
+int forEachFrozenHelper(const FrozenRBTree *frozen, long unsigned k, forEachFunc func, void *args)
+{
+	if(k > frozen->size)
+	{
+		return SUCCESS;
+	}
+	if(forEachFrozenHelper(frozen, 2 * k, func, args) == 0 || func(frozen->items[k], args) == 0)
+	{
+		return FAIL;
+	}
+	return forEachFrozenHelper(frozen, 2 * k + 1, func, args);
+}
+
+/**
+ * Activate a function on each item of the snapshot in an ascending order. if one of the activations of the
+ * function returns 0, the process stops.
+ * @param frozen: the snapshot with all the items.
+ * @param func: the function to activate on all items.
+ * @param args: more optional arguments to the function (may be null if the given function support it).
+ * @return: 0 on failure, other on success.
+ */
+int forEachFrozenRBTree(const FrozenRBTree *frozen, forEachFunc func, void *args)
+{
+	if(frozen == NULL || func == NULL)
+	{
+		return FAIL;
+	}
+	return forEachFrozenHelper(frozen, 1, func, args);
+}
+
+/**
+ * free the memory of the snapshot (the items themselves belong to the tree and are not freed).
+ * @param frozen: pointer to the snapshot to free.
+ */
+void freeFrozenRBTree(FrozenRBTree **frozen)
+{
+	if(*frozen != NULL)
+	{
+		free((*frozen)->items);
+		free(*frozen);
+	}
+	*frozen = NULL;
+}
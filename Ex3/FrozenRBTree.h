@@ -0,0 +1,68 @@
+#ifndef RBTREE_FROZENRBTREE_H
+#define RBTREE_FROZENRBTREE_H
+
+#include "RBTree.h"
+
+/**
+ * a read only snapshot of a tree. the items are kept in a single array in Eytzinger (BFS) order:
+ * the children of the item at index k are at 2k and 2k + 1, so a search walks down the array and
+ * the next levels can be prefetched ahead of the comparisons.
+ * the snapshot does not own the items, it points to the items of the tree it was built from, so it
+ * must be rebuilt (refreezeRBTree) after the tree changes and must not outlive the items.
+ */
+typedef struct FrozenRBTree
+{
+	const void **items;
+	CompareFunc compFunc;
+	long unsigned size;
+	long unsigned capacity;
+} FrozenRBTree;
+
+/**
+ * builds a read only snapshot of the tree in O(n).
+ * @param tree: the tree to take the snapshot of.
+ * @return: pointer to the new snapshot, NULL on failure.
+ */
+FrozenRBTree *RBTreeFreeze(const RBTree *tree);
+
+/**
+ * rebuilds a snapshot from the current items of the tree in O(n), reusing its memory when possible.
+ * @param frozen: the snapshot to rebuild.
+ * @param tree: the tree to take the snapshot of.
+ * @return: 0 on failure (the snapshot is left empty), other on success.
+ */
+int refreezeRBTree(FrozenRBTree *frozen, const RBTree *tree);
+
+/**
+ * check whether the snapshot contains this item.
+ * @param frozen: the snapshot to search in.
+ * @param data: item to check.
+ * @return: 0 if the item is not in the snapshot, other if it is.
+ */
+int frozenRBTreeContains(const FrozenRBTree *frozen, const void *data);
+
+/**
+ * finds the smallest item of the snapshot which is not lower than data.
+ * @param frozen: the snapshot to search in.
+ * @param data: the item to compare to.
+ * @return: the found item, NULL if all the items are lower than data.
+ */
+const void *frozenRBTreeLowerBound(const FrozenRBTree *frozen, const void *data);
+
+/**
+ * Activate a function on each item of the snapshot in an ascending order. if one of the activations of the
+ * function returns 0, the process stops.
+ * @param frozen: the snapshot with all the items.
+ * @param func: the function to activate on all items.
+ * @param args: more optional arguments to the function (may be null if the given function support it).
+ * @return: 0 on failure, other on success.
+ */
+int forEachFrozenRBTree(const FrozenRBTree *frozen, forEachFunc func, void *args);
+
+/**
+ * free the memory of the snapshot (the items themselves belong to the tree and are not freed).
+ * @param frozen: pointer to the snapshot to free.
+ */
+void freeFrozenRBTree(FrozenRBTree **frozen);
+
+#endif //RBTREE_FROZENRBTREE_H
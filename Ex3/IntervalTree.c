@@ -0,0 +1,272 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include "IntervalTree.h"
+
+#define FAIL 0
+#define SUCCESS 1
+
+/**
+ * an item of the tree: the interval and the maximal high endpoint of the subtree of its node.
+ */
+typedef struct IntervalItem
+{
+	Interval interval;
+	double maxHigh;
+} IntervalItem;
+
+/**
+ * the tree of the intervals and the function to free their values.
+ */
+struct IntervalTree
+{
+	RBTree *tree;
+	FreeFunc valueFreeFunc;
+};
+
+/**
+ * the arguments of a query
+ */
+typedef struct IntervalQuery
+{
+	double low;
+	double high;
+	forEachIntervalFunc func;
+	void *args;
+} IntervalQuery;
+
+/**
+ * orders the intervals by their low endpoints, then by their high endpoints, then by the addresses
+ * of their values (CompareFunc)
+ * @param a an IntervalItem
+ * @param b an IntervalItem
+ * @return the order of a and b
+ */
+int intervalCompare(const void *a, const void *b)
+{
+	const Interval* first = &((const IntervalItem *) a)->interval;
+	const Interval* second = &((const IntervalItem *) b)->interval;
+	if(first->low != second->low)
+	{
+		return first->low < second->low ? -1 : 1;
+	}
+	if(first->high != second->high)
+	{
+		return first->high < second->high ? -1 : 1;
+	}
+	uintptr_t firstValue = (uintptr_t) first->value, secondValue = (uintptr_t) second->value;
+	return (firstValue > secondValue) - (firstValue < secondValue);
+}
+
+/**
+ * sets the maximal high endpoint of an item from its interval and its children (AugmentFunc)
+ * @param data the IntervalItem
+ * @param left the item of the left child, may be NULL
+ * @param right the item of the right child, may be NULL
+ */
+void updateMaxHigh(void *data, const void *left, const void *right)
+{
+	IntervalItem* item = (IntervalItem *) data;
+	item->maxHigh = item->interval.high;
+	if(left != NULL && ((const IntervalItem *) left)->maxHigh > item->maxHigh)
+	{
+		item->maxHigh = ((const IntervalItem *) left)->maxHigh;
+	}
+	if(right != NULL && ((const IntervalItem *) right)->maxHigh > item->maxHigh)
+	{
+		item->maxHigh = ((const IntervalItem *) right)->maxHigh;
+	}
+}
+
+/**
+ * constructs a new interval tree.
+ * @param valueFreeFunc: a function to free a value (may be NULL if the tree does not own the values).
+ * @return: pointer to the new tree, NULL on failure.
+ */
+IntervalTree *newIntervalTree(FreeFunc valueFreeFunc)
+{
+	IntervalTree* tree = (IntervalTree *) malloc(sizeof(IntervalTree));
+	if(tree == NULL)
+	{
+		return NULL;
+	}
+	tree->tree = newRBTree(intervalCompare, free);
+	if(tree->tree == NULL || RBTreeAttachAugment(tree->tree, updateMaxHigh) == 0)
+	{
+		freeRBTree(&tree->tree);
+		free(tree);
+		return NULL;
+	}
+	tree->valueFreeFunc = valueFreeFunc;
+	return tree;
+}
+
+/**
+ * add an interval to the tree
+ * @param tree: the tree to add the interval to.
+ * @param low: the low endpoint.
+ * @param high: the high endpoint, not lower than low.
+ * @param value: the value of the interval.
+ * @return: 0 on failure, other on success. (if the interval is already in the tree with the same
+ * value - failure).
+ */
+int insertToIntervalTree(IntervalTree *tree, double low, double high, void *value)
+{
+	// also rejects NaN endpoints, which have no order.
+	if(tree == NULL || !(low <= high))
+	{
+		return FAIL;
+	}
+	IntervalItem* item = (IntervalItem *) malloc(sizeof(IntervalItem));
+	if(item == NULL)
+	{
+		return FAIL;
+	}
+	item->interval.low = low;
+	item->interval.high = high;
+	item->interval.value = value;
+	item->maxHigh = high;
+	if(insertToRBTree(tree->tree, item) == 0)
+	{
+		free(item);
+		return FAIL;
+	}
+	return SUCCESS;
+}
+
+/**
+ * remove an interval from the tree, and free its value with the value FreeFunc of the tree.
+ * @param tree: the tree to remove the interval from.
+ * @param low: the low endpoint.
+ * @param high: the high endpoint.
+ * @param value: the value the interval was added with.
+ * @return: 0 on failure, other on success. (if the interval is not in the tree with this value -
+ * failure).
+ */
+int deleteFromIntervalTree(IntervalTree *tree, double low, double high, void *value)
+{
+	if(tree == NULL)
+	{
+		return FAIL;
+	}
+	IntervalItem key = {{low, high, value}, high};
+	if(deleteFromRBTree(tree->tree, &key) == 0)
+	{
+		return FAIL;
+	}
+	if(tree->valueFreeFunc != NULL)
+	{
+		tree->valueFreeFunc(value);
+	}
+	return SUCCESS;
+}
+
+/**
+ * get the number of intervals in the tree.
+ * @param tree: the tree.
+ * @return: the number of intervals.
+ */
+long unsigned intervalTreeSize(const IntervalTree *tree)
+{
+	if(tree == NULL)
+	{
+		return 0;
+	}
+	return tree->tree->size;
+}
+
+/**
+ * the in order walk of a query over a subtree, skipping the subtrees which cannot overlap
+ * @param node the root of the subtree
+ * @param query the query
+ * @return 0 if the function failed, else 1
+ */
+int overlapHelper(const Node *node, const IntervalQuery *query)
+{
+	// no interval of the subtree reaches the queried range.
+	if(node == NULL || ((const IntervalItem *) node->data)->maxHigh < query->low)
+	{
+		return SUCCESS;
+	}
+	if(overlapHelper(node->left, query) == 0)
+	{
+		return FAIL;
+	}
+	const Interval* interval = &((const IntervalItem *) node->data)->interval;
+	// this interval and all the intervals after it start after the queried range.
+	if(interval->low > query->high)
+	{
+		return SUCCESS;
+	}
+	if(interval->high >= query->low && query->func(interval, query->args) == 0)
+	{
+		return FAIL;
+	}
+	return overlapHelper(node->right, query);
+}
+
+/**
+ * Activate a function on every interval which overlaps [low, high] (shares at least one point with
+ * it), in the ascending order of the low endpoints. if one of the activations of the function
+ * returns 0, the process stops.
+ * @param tree: the tree.
+ * @param low: the low endpoint of the queried range.
+ * @param high: the high endpoint of the queried range.
+ * @param func: the function to activate on the overlapping intervals.
+ * @param args: more optional arguments to the function (may be null if the given function support it).
+ * @return: 0 on failure, other on success.
+ */
+int forEachOverlappingInterval(const IntervalTree *tree, double low, double high, forEachIntervalFunc func,
+							   void *args)
+{
+	if(tree == NULL || func == NULL || !(low <= high))
+	{
+		return FAIL;
+	}
+	IntervalQuery query = {low, high, func, args};
+	return overlapHelper(tree->tree->root, &query);
+}
+
+/**
+ * Activate a function on every interval which contains a point (a stabbing query), in the ascending
+ * order of the low endpoints. if one of the activations of the function returns 0, the process stops.
+ * @param tree: the tree.
+ * @param point: the point.
+ * @param func: the function to activate on the intervals which contain the point.
+ * @param args: more optional arguments to the function (may be null if the given function support it).
+ * @return: 0 on failure, other on success.
+ */
+int forEachIntervalContaining(const IntervalTree *tree, double point, forEachIntervalFunc func, void *args)
+{
+	return forEachOverlappingInterval(tree, point, point, func, args);
+}
+
+/**
+ * frees the value of an interval (forEachFunc)
+ * @param object the IntervalItem
+ * @param args the FreeFunc of the values
+ * @return 1
+ */
+int freeIntervalValue(const void *object, void *args)
+{
+	FreeFunc* valueFreeFunc = (FreeFunc *) args;
+	(*valueFreeFunc)(((const IntervalItem *) object)->interval.value);
+	return SUCCESS;
+}
+
+/**
+ * free all memory of the data structure.
+ * @param tree: pointer to the tree to free.
+ */
+void freeIntervalTree(IntervalTree **tree)
+{
+	if(*tree != NULL)
+	{
+		if((*tree)->valueFreeFunc != NULL)
+		{
+			forEachRBTree((*tree)->tree, freeIntervalValue, &(*tree)->valueFreeFunc);
+		}
+		freeRBTree(&(*tree)->tree);
+		free(*tree);
+	}
+	*tree = NULL;
+}
@@ -0,0 +1,101 @@
+#ifndef RBTREE_INTERVALTREE_H
+#define RBTREE_INTERVALTREE_H
+
+#include "RBTree.h"
+
+/**
+ * a closed interval [low, high] and the value stored with it.
+ */
+typedef struct Interval
+{
+	double low;
+	double high;
+	void *value;
+} Interval;
+
+/**
+ * a function to apply on the intervals found by a query.
+ * @interval: an interval of the tree, it must not be changed.
+ * @args: more optional arguments to the function.
+ * @return: 0 on failure (stops the query), other on success.
+ */
+typedef int (*forEachIntervalFunc)(const Interval *interval, void *args);
+
+/**
+ * a set of intervals kept in an RBTree ordered by their low endpoints, where every item also keeps
+ * the maximal high endpoint of its subtree (an augmented RBTree). a query skips every subtree whose
+ * maximal high endpoint is before the queried range and every right subtree whose items start after
+ * it, so it visits the path to the first overlapping interval and the subtrees which hold the
+ * overlapping intervals, instead of every interval like forEachRBTree.
+ * the same interval may be stored with different values.
+ */
+typedef struct IntervalTree IntervalTree;
+
+/**
+ * constructs a new interval tree.
+ * @param valueFreeFunc: a function to free a value (may be NULL if the tree does not own the values).
+ * @return: pointer to the new tree, NULL on failure.
+ */
+IntervalTree *newIntervalTree(FreeFunc valueFreeFunc);
+
+/**
+ * add an interval to the tree
+ * @param tree: the tree to add the interval to.
+ * @param low: the low endpoint.
+ * @param high: the high endpoint, not lower than low.
+ * @param value: the value of the interval.
+ * @return: 0 on failure, other on success. (if the interval is already in the tree with the same
+ * value - failure).
+ */
+int insertToIntervalTree(IntervalTree *tree, double low, double high, void *value);
+
+/**
+ * remove an interval from the tree, and free its value with the value FreeFunc of the tree.
+ * @param tree: the tree to remove the interval from.
+ * @param low: the low endpoint.
+ * @param high: the high endpoint.
+ * @param value: the value the interval was added with.
+ * @return: 0 on failure, other on success. (if the interval is not in the tree with this value -
+ * failure).
+ */
+int deleteFromIntervalTree(IntervalTree *tree, double low, double high, void *value);
+
+/**
+ * get the number of intervals in the tree.
+ * @param tree: the tree.
+ * @return: the number of intervals.
+ */
+long unsigned intervalTreeSize(const IntervalTree *tree);
+
+/**
+ * Activate a function on every interval which overlaps [low, high] (shares at least one point with
+ * it), in the ascending order of the low endpoints. if one of the activations of the function
+ * returns 0, the process stops.
+ * @param tree: the tree.
+ * @param low: the low endpoint of the queried range.
+ * @param high: the high endpoint of the queried range.
+ * @param func: the function to activate on the overlapping intervals.
+ * @param args: more optional arguments to the function (may be null if the given function support it).
+ * @return: 0 on failure, other on success.
+ */
+int forEachOverlappingInterval(const IntervalTree *tree, double low, double high, forEachIntervalFunc func,
+							   void *args);
+
+/**
+ * Activate a function on every interval which contains a point (a stabbing query), in the ascending
+ * order of the low endpoints. if one of the activations of the function returns 0, the process stops.
+ * @param tree: the tree.
+ * @param point: the point.
+ * @param func: the function to activate on the intervals which contain the point.
+ * @param args: more optional arguments to the function (may be null if the given function support it).
+ * @return: 0 on failure, other on success.
+ */
+int forEachIntervalContaining(const IntervalTree *tree, double point, forEachIntervalFunc func, void *args);
+
+/**
+ * free all memory of the data structure.
+ * @param tree: pointer to the tree to free.
+ */
+void freeIntervalTree(IntervalTree **tree);
+
+#endif //RBTREE_INTERVALTREE_H
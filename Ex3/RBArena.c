@@ -0,0 +1,571 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include "RBArena.h"
+
+#define FAIL 0
+#define SUCCESS 1
+#define CHUNK_SIZE ((size_t) 2 << 20)
+#define ARENA_PAGE_SIZE ((size_t) 4096)
+#define PAGES_PER_CHUNK (CHUNK_SIZE / ARENA_PAGE_SIZE)
+#define ALIGNMENT 16
+#define SIZE_CLASSES 64
+#define MAX_SMALL_SIZE (ALIGNMENT * SIZE_CLASSES)
+#define MAX_MEDIUM_SIZE (CHUNK_SIZE / 2)
+#define UNUSED_PAGE 0
+#define LARGE_PAGE 0xff
+#define MEDIUM_PAGE 0xfe
+#define FREE_RUN_PAGE 0xfd
+#define KILO 1024
+
+/**
+ * a huge page aligned mapping. the header takes the first page of the chunk, and records the size
+ * class of every other page (0 for pages not handed out yet), so a freed pointer finds its size
+ * class by masking its address. an allocation larger than MAX_SMALL_SIZE and up to MAX_MEDIUM_SIZE
+ * is a run of whole pages, whose first and last pages are marked MEDIUM_PAGE (FREE_RUN_PAGE once
+ * freed) and keep the length of the run, so a freed run finds its free neighbours and merges with
+ * them. a larger allocation gets a chunk of its own.
+ */
+typedef struct ArenaChunk
+{
+	struct ArenaChunk *next;
+	size_t mappedSize;
+	int hugeTlb;
+	unsigned char pageClass[PAGES_PER_CHUNK];
+	unsigned short runPages[PAGES_PER_CHUNK];
+} ArenaChunk;
+
+/**
+ * a freed run of pages, kept in its own first page.
+ */
+typedef struct FreeRun
+{
+	struct FreeRun *next;
+	struct FreeRun *prev;
+} FreeRun;
+
+/**
+ * the arena: the chunks, the page being carved for every size class and the freed blocks and runs.
+ */
+struct RBArena
+{
+	ArenaChunk *chunks;
+	ArenaChunk *current;
+	size_t nextPage;
+	char *bumpCursor[SIZE_CLASSES];
+	char *bumpEnd[SIZE_CLASSES];
+	void *freeLists[SIZE_CLASSES];
+	FreeRun *freeRuns;
+	size_t usedBytes;
+	int hugeTlbFailed;
+};
+
+/**
+ * constructs a new empty arena.
+ * @return: pointer to the new arena, NULL on failure.
+ */
+RBArena *newRBArena(void)
+{
+	RBArena* arena = (RBArena *) malloc(sizeof(RBArena));
+	if(arena == NULL)
+	{
+		return NULL;
+	}
+	arena->chunks = NULL;
+	arena->current = NULL;
+	arena->nextPage = PAGES_PER_CHUNK;
+	for(int i = 0; i < SIZE_CLASSES; i++)
+	{
+		arena->bumpCursor[i] = NULL;
+		arena->bumpEnd[i] = NULL;
+		arena->freeLists[i] = NULL;
+	}
+	arena->freeRuns = NULL;
+	arena->usedBytes = 0;
+	arena->hugeTlbFailed = 0;
+	return arena;
+}
+
+/**
+ * maps a chunk: first from the reserved huge pages, else an aligned anonymous mapping which is
+ * advised to be backed by transparent huge pages
+ * @param arena the arena
+ * @param size the size of the chunk, a multiple of CHUNK_SIZE
+ * @return pointer to the new chunk, NULL on failure
+ */
+ArenaChunk *mapChunk(RBArena *arena, size_t size)
+{
+#ifdef MAP_HUGETLB
+	if(arena->hugeTlbFailed == 0)
+	{
+		void* huge = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if(huge != MAP_FAILED)
+		{
+			ArenaChunk* chunk = (ArenaChunk *) huge;
+			chunk->hugeTlb = 1;
+			chunk->mappedSize = size;
+			return chunk;
+		}
+		arena->hugeTlbFailed = 1;
+	}
+#endif
+	char* raw = (char *) mmap(NULL, size + CHUNK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(raw == (char *) MAP_FAILED)
+	{
+		return NULL;
+	}
+	char* aligned = (char *) (((size_t) raw + CHUNK_SIZE - 1) & ~(CHUNK_SIZE - 1));
+	if(aligned > raw)
+	{
+		munmap(raw, (size_t) (aligned - raw));
+	}
+	size_t tail = (size_t) (raw + size + CHUNK_SIZE - (aligned + size));
+	if(tail > 0)
+	{
+		munmap(aligned + size, tail);
+	}
+#ifdef MADV_HUGEPAGE
+	madvise(aligned, size, MADV_HUGEPAGE);
+#endif
+	ArenaChunk* chunk = (ArenaChunk *) aligned;
+	chunk->hugeTlb = 0;
+	chunk->mappedSize = size;
+	return chunk;
+}
+
+/**
+ * maps a chunk and links it to the arena
+ * @param arena the arena
+ * @param size the size of the chunk, a multiple of CHUNK_SIZE
+ * @return pointer to the new chunk, NULL on failure
+ */
+ArenaChunk *addChunk(RBArena *arena, size_t size)
+{
+	ArenaChunk* chunk = mapChunk(arena, size);
+	if(chunk == NULL)
+	{
+		return NULL;
+	}
+	for(size_t i = 0; i < PAGES_PER_CHUNK; i++)
+	{
+		chunk->pageClass[i] = UNUSED_PAGE;
+	}
+	chunk->next = arena->chunks;
+	arena->chunks = chunk;
+	return chunk;
+}
+
+/**
+ * finds a page of a chunk
+ * @param chunk the chunk
+ * @param page the index of the page
+ * @return pointer to the page
+ */
+char *chunkPage(const ArenaChunk *chunk, size_t page)
+{
+	return (char *) chunk + page * ARENA_PAGE_SIZE;
+}
+
+/**
+ * adds a run of pages to the free runs of the arena
+ * @param arena the arena
+ * @param chunk the chunk of the run
+ * @param first the first page of the run
+ * @param pages the number of pages
+ */
+void linkRun(RBArena *arena, ArenaChunk *chunk, size_t first, size_t pages)
+{
+	chunk->pageClass[first] = FREE_RUN_PAGE;
+	chunk->pageClass[first + pages - 1] = FREE_RUN_PAGE;
+	chunk->runPages[first] = (unsigned short) pages;
+	chunk->runPages[first + pages - 1] = (unsigned short) pages;
+	FreeRun* run = (FreeRun *) chunkPage(chunk, first);
+	run->prev = NULL;
+	run->next = arena->freeRuns;
+	if(arena->freeRuns != NULL)
+	{
+		arena->freeRuns->prev = run;
+	}
+	arena->freeRuns = run;
+}
+
+/**
+ * removes a run from the free runs of the arena
+ * @param arena the arena
+ * @param run the run
+ */
+void unlinkRun(RBArena *arena, FreeRun *run)
+{
+	if(run->prev != NULL)
+	{
+		run->prev->next = run->next;
+	}
+	else
+	{
+		arena->freeRuns = run->next;
+	}
+	if(run->next != NULL)
+	{
+		run->next->prev = run->prev;
+	}
+}
+
+/**
+ * clears the marks of the first and last pages of a run which stops being a run of its own
+ * @param chunk the chunk of the run
+ * @param first the first page of the run
+ * @param pages the number of pages
+ */
+void clearRunMarks(ArenaChunk *chunk, size_t first, size_t pages)
+{
+	chunk->pageClass[first] = UNUSED_PAGE;
+	chunk->pageClass[first + pages - 1] = UNUSED_PAGE;
+}
+
+/**
+ * frees a run of pages: it is merged with the free runs around it, and given back to the unused
+ * pages of the current chunk if it ends at them. the marks of every run which is merged are
+ * cleared, so only the first and last pages of the merged run are marked.
+ * @param arena the arena
+ * @param chunk the chunk of the run
+ * @param first the first page of the run
+ * @param pages the number of pages
+ */
+void releaseRun(RBArena *arena, ArenaChunk *chunk, size_t first, size_t pages)
+{
+	clearRunMarks(chunk, first, pages);
+	size_t end = first + pages;
+	if(end < PAGES_PER_CHUNK && chunk->pageClass[end] == FREE_RUN_PAGE)
+	{
+		size_t after = chunk->runPages[end];
+		unlinkRun(arena, (FreeRun *) chunkPage(chunk, end));
+		clearRunMarks(chunk, end, after);
+		pages += after;
+	}
+	if(chunk->pageClass[first - 1] == FREE_RUN_PAGE)
+	{
+		size_t before = chunk->runPages[first - 1];
+		first -= before;
+		pages += before;
+		unlinkRun(arena, (FreeRun *) chunkPage(chunk, first));
+		clearRunMarks(chunk, first, before);
+	}
+	if(chunk == arena->current && first + pages == arena->nextPage)
+	{
+		arena->nextPage = first;
+		return;
+	}
+	linkRun(arena, chunk, first, pages);
+}
+
+/**
+ * makes sure the current chunk has a number of unused pages, else maps a new current chunk (the
+ * unused pages of the old one become a free run)
+ * @param arena the arena
+ * @param pages the number of pages
+ * @return 0 on failure, 1 on success
+ */
+int reservePages(RBArena *arena, size_t pages)
+{
+	if(arena->nextPage + pages <= PAGES_PER_CHUNK)
+	{
+		return SUCCESS;
+	}
+	ArenaChunk* chunk = addChunk(arena, CHUNK_SIZE);
+	if(chunk == NULL)
+	{
+		return FAIL;
+	}
+	if(arena->current != NULL && arena->nextPage < PAGES_PER_CHUNK)
+	{
+		linkRun(arena, arena->current, arena->nextPage, PAGES_PER_CHUNK - arena->nextPage);
+	}
+	arena->current = chunk;
+	arena->nextPage = 1;
+	return SUCCESS;
+}
+
+/**
+ * hands a new page to a size class
+ * @param arena the arena
+ * @param sizeClass the size class
+ * @return 0 on failure, 1 on success
+ */
+int takePage(RBArena *arena, int sizeClass)
+{
+	if(reservePages(arena, 1) == FAIL)
+	{
+		return FAIL;
+	}
+	arena->current->pageClass[arena->nextPage] = (unsigned char) (sizeClass + 1);
+	arena->bumpCursor[sizeClass] = chunkPage(arena->current, arena->nextPage);
+	arena->bumpEnd[sizeClass] = arena->bumpCursor[sizeClass] + ARENA_PAGE_SIZE;
+	arena->nextPage++;
+	return SUCCESS;
+}
+
+/**
+ * allocates a block larger than MAX_SMALL_SIZE and up to MAX_MEDIUM_SIZE as a run of pages: the
+ * first free run which is long enough is split, else the run is taken from the unused pages
+ * @param arena the arena
+ * @param size the size to allocate
+ * @return pointer to the block, NULL on failure
+ */
+void *allocMedium(RBArena *arena, size_t size)
+{
+	size_t pages = (size + ARENA_PAGE_SIZE - 1) / ARENA_PAGE_SIZE;
+	ArenaChunk* chunk = NULL;
+	size_t first = 0;
+	FreeRun* run = arena->freeRuns;
+	while(run != NULL)
+	{
+		chunk = (ArenaChunk *) ((size_t) run & ~(CHUNK_SIZE - 1));
+		first = ((size_t) run - (size_t) chunk) / ARENA_PAGE_SIZE;
+		if(chunk->runPages[first] >= pages)
+		{
+			break;
+		}
+		run = run->next;
+	}
+	if(run != NULL)
+	{
+		size_t runPages = chunk->runPages[first];
+		unlinkRun(arena, run);
+		if(runPages > pages)
+		{
+			linkRun(arena, chunk, first + pages, runPages - pages);
+		}
+	}
+	else
+	{
+		if(reservePages(arena, pages) == FAIL)
+		{
+			return NULL;
+		}
+		chunk = arena->current;
+		first = arena->nextPage;
+		arena->nextPage += pages;
+	}
+	chunk->pageClass[first] = MEDIUM_PAGE;
+	chunk->pageClass[first + pages - 1] = MEDIUM_PAGE;
+	chunk->runPages[first] = (unsigned short) pages;
+	arena->usedBytes += pages * ARENA_PAGE_SIZE;
+	return chunkPage(chunk, first);
+}
+
+/**
+ * allocates a block larger than MAX_MEDIUM_SIZE in a chunk of its own
+ * @param arena the arena
+ * @param size the size to allocate
+ * @return pointer to the block, NULL on failure
+ */
+void *allocLarge(RBArena *arena, size_t size)
+{
+	size_t chunkSize = (size + ARENA_PAGE_SIZE + CHUNK_SIZE - 1) & ~(CHUNK_SIZE - 1);
+	ArenaChunk* chunk = addChunk(arena, chunkSize);
+	if(chunk == NULL)
+	{
+		return NULL;
+	}
+	chunk->pageClass[1] = LARGE_PAGE;
+	arena->usedBytes += chunkSize - ARENA_PAGE_SIZE;
+	return (char *) chunk + ARENA_PAGE_SIZE;
+}
+
+/**
+ * allocates memory from the arena (RBAllocator alloc function).
+ * @param size: the size to allocate.
+ * @param arena: pointer to the arena.
+ * @return: pointer to the allocated memory (aligned to 16 bytes), NULL on failure.
+ */
+void *arenaAlloc(size_t size, void *arena)
+{
+	RBArena* owner = (RBArena *) arena;
+	if(owner == NULL)
+	{
+		return NULL;
+	}
+	if(size > MAX_MEDIUM_SIZE)
+	{
+		return allocLarge(owner, size);
+	}
+	if(size > MAX_SMALL_SIZE)
+	{
+		return allocMedium(owner, size);
+	}
+	int sizeClass = size == 0 ? 0 : (int) ((size - 1) / ALIGNMENT);
+	size_t blockSize = (size_t) (sizeClass + 1) * ALIGNMENT;
+	void* block = owner->freeLists[sizeClass];
+	if(block != NULL)
+	{
+		owner->freeLists[sizeClass] = *(void **) block;
+	}
+	else
+	{
+		if(owner->bumpCursor[sizeClass] == NULL || owner->bumpCursor[sizeClass] + blockSize > owner->bumpEnd[sizeClass])
+		{
+			if(takePage(owner, sizeClass) == FAIL)
+			{
+				return NULL;
+			}
+		}
+		block = owner->bumpCursor[sizeClass];
+		owner->bumpCursor[sizeClass] += blockSize;
+	}
+	owner->usedBytes += blockSize;
+	return block;
+}
+
+/**
+ * returns memory to the arena (RBAllocator free function).
+ * @param memory: memory returned by arenaAlloc of the same arena.
+ * @param arena: pointer to the arena.
+ */
+void arenaFree(void *memory, void *arena)
+{
+	RBArena* owner = (RBArena *) arena;
+	if(memory == NULL || owner == NULL)
+	{
+		return;
+	}
+	ArenaChunk* chunk = (ArenaChunk *) ((size_t) memory & ~(CHUNK_SIZE - 1));
+	size_t page = ((size_t) memory - (size_t) chunk) / ARENA_PAGE_SIZE;
+	if(chunk->pageClass[page] == LARGE_PAGE)
+	{
+		ArenaChunk** link = &owner->chunks;
+		while(*link != chunk)
+		{
+			link = &(*link)->next;
+		}
+		*link = chunk->next;
+		owner->usedBytes -= chunk->mappedSize - ARENA_PAGE_SIZE;
+		munmap(chunk, chunk->mappedSize);
+		return;
+	}
+	if(chunk->pageClass[page] == MEDIUM_PAGE)
+	{
+		owner->usedBytes -= chunk->runPages[page] * ARENA_PAGE_SIZE;
+		releaseRun(owner, chunk, page, chunk->runPages[page]);
+		return;
+	}
+	int sizeClass = chunk->pageClass[page] - 1;
+	*(void **) memory = owner->freeLists[sizeClass];
+	owner->freeLists[sizeClass] = memory;
+	owner->usedBytes -= (size_t) (sizeClass + 1) * ALIGNMENT;
+}
+
+/**
+ * fills an RBAllocator which allocates from the arena, to pass to newRBTreeWithAllocator.
+ * @param arena: the arena.
+ * @param allocator: the allocator to fill.
+ */
+void RBArenaAllocator(RBArena *arena, RBAllocator *allocator)
+{
+	allocator->alloc = arenaAlloc;
+	allocator->free = arenaFree;
+	allocator->context = arena;
+}
+
+/**
+ * the number of bytes of a range which fall inside the chunks of the arena
+ * @param arena the arena
+ * @param start the start of the range
+ * @param end the end of the range
+ * @return the number of bytes
+ */
+size_t bytesInArena(const RBArena *arena, size_t start, size_t end)
+{
+	size_t overlap = 0;
+	for(const ArenaChunk* chunk = arena->chunks; chunk != NULL; chunk = chunk->next)
+	{
+		size_t chunkStart = (size_t) chunk;
+		size_t chunkEnd = chunkStart + chunk->mappedSize;
+		if(chunk->hugeTlb == 0 && chunkStart < end && start < chunkEnd)
+		{
+			overlap += (chunkEnd < end ? chunkEnd : end) - (chunkStart > start ? chunkStart : start);
+		}
+	}
+	return overlap;
+}
+
+/**
+ * counts the transparent huge pages backing the arena from /proc/self/smaps. the kernel may merge
+ * the arena's mappings with neighbours, so the huge pages of a mapping are split by overlap.
+ * @param arena the arena
+ * @return the number of bytes on transparent huge pages (0 if smaps is not available)
+ */
+size_t transparentHugeBytes(const RBArena *arena)
+{
+	FILE* smaps = fopen("/proc/self/smaps", "r");
+	if(smaps == NULL)
+	{
+		return 0;
+	}
+	char line[KILO];
+	size_t hugeBytes = 0;
+	size_t overlap = 0;
+	size_t mappingSize = 0;
+	while(fgets(line, sizeof(line), smaps) != NULL)
+	{
+		unsigned long start = 0, end = 0, kiloBytes = 0;
+		if(sscanf(line, "%lx-%lx ", &start, &end) == 2)
+		{
+			overlap = bytesInArena(arena, start, end);
+			mappingSize = end - start;
+		}
+		else if(overlap > 0 && sscanf(line, "AnonHugePages: %lu kB", &kiloBytes) == 1)
+		{
+			hugeBytes += (size_t) ((double) kiloBytes * KILO * ((double) overlap / (double) mappingSize));
+		}
+	}
+	fclose(smaps);
+	return hugeBytes;
+}
+
+/**
+ * get the memory usage of the arena, including how much of it ended up on huge pages.
+ * @param arena: the arena.
+ * @param stats: where to write the usage.
+ * @return: 0 on failure, other on success.
+ */
+int getRBArenaStats(const RBArena *arena, RBArenaStats *stats)
+{
+	if(arena == NULL || stats == NULL)
+	{
+		return FAIL;
+	}
+	stats->mappedBytes = 0;
+	stats->hugePageBytes = 0;
+	stats->usedBytes = arena->usedBytes;
+	for(const ArenaChunk* chunk = arena->chunks; chunk != NULL; chunk = chunk->next)
+	{
+		stats->mappedBytes += chunk->mappedSize;
+		if(chunk->hugeTlb)
+		{
+			stats->hugePageBytes += chunk->mappedSize;
+		}
+	}
+	stats->hugePageBytes += transparentHugeBytes(arena);
+	return SUCCESS;
+}
+
+/**
+ * release all the memory of the arena at once.
+ * @param arena: pointer to the arena to free.
+ */
+void freeRBArena(RBArena **arena)
+{
+	if(*arena != NULL)
+	{
+		ArenaChunk* chunk = (*arena)->chunks;
+		while(chunk != NULL)
+		{
+			ArenaChunk* next = chunk->next;
+			munmap(chunk, chunk->mappedSize);
+			chunk = next;
+		}
+		free(*arena);
+	}
+	*arena = NULL;
+}
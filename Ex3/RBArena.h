@@ -0,0 +1,69 @@
+#ifndef RBTREE_RBARENA_H
+#define RBTREE_RBARENA_H
+
+#include "RBTree.h"
+
+/**
+ * the memory usage of an arena.
+ */
+typedef struct RBArenaStats
+{
+	size_t mappedBytes; // the memory the arena took from the system.
+	size_t hugePageBytes; // the part of mappedBytes which is backed by huge pages.
+	size_t usedBytes; // the memory handed out by arenaAlloc and not freed yet.
+} RBArenaStats;
+
+/**
+ * an arena for the nodes and the items of trees. the memory is mapped in huge page sized and
+ * aligned chunks, with MAP_HUGETLB when huge pages are reserved, or else with madvise(MADV_HUGEPAGE)
+ * so transparent huge pages can back it, and falls back to normal pages when neither is available.
+ * small allocations are served from per size free lists, so freed nodes are reused. allocations up
+ * to half a chunk are runs of pages in the same chunks, merged with their free neighbours when
+ * freed, and only larger ones are mapped on their own.
+ * an arena is not thread safe.
+ */
+typedef struct RBArena RBArena;
+
+/**
+ * constructs a new empty arena.
+ * @return: pointer to the new arena, NULL on failure.
+ */
+RBArena *newRBArena(void);
+
+/**
+ * allocates memory from the arena (RBAllocator alloc function).
+ * @param size: the size to allocate.
+ * @param arena: pointer to the arena.
+ * @return: pointer to the allocated memory (aligned to 16 bytes), NULL on failure.
+ */
+void *arenaAlloc(size_t size, void *arena);
+
+/**
+ * returns memory to the arena (RBAllocator free function).
+ * @param memory: memory returned by arenaAlloc of the same arena.
+ * @param arena: pointer to the arena.
+ */
+void arenaFree(void *memory, void *arena);
+
+/**
+ * fills an RBAllocator which allocates from the arena, to pass to newRBTreeWithAllocator.
+ * @param arena: the arena.
+ * @param allocator: the allocator to fill.
+ */
+void RBArenaAllocator(RBArena *arena, RBAllocator *allocator);
+
+/**
+ * get the memory usage of the arena, including how much of it ended up on huge pages.
+ * @param arena: the arena.
+ * @param stats: where to write the usage.
+ * @return: 0 on failure, other on success.
+ */
+int getRBArenaStats(const RBArena *arena, RBArenaStats *stats);
+
+/**
+ * release all the memory of the arena at once.
+ * @param arena: pointer to the arena to free.
+ */
+void freeRBArena(RBArena **arena);
+
+#endif //RBTREE_RBARENA_H
@@ -1,821 +1,3991 @@
 #include <string.h>
 #include <stdlib.h>
+#include <pthread.h>
 #include "RBTree.h"
 
 #define FAIL 0
 #define SUCCESS 1
+#define BATCH_GROUP_SIZE 16
+#define BATCH_OP_FAILED 0
+#define BATCH_OP_APPLIED 1
+#define BATCH_OP_UNDONE 2 // an insert whose item a later delete of the batch removed.
+#define BLOOM_BLOCK_SIZE 64
+#define BLOOM_PROBES 4
+#define BLOOM_COUNTERS_PER_ITEM 8
+#define BLOOM_MAX_COUNT 255
+#define HASH_INDEX_MIN_CAPACITY 16
+#define MAX_INLINE_SIZE 64
+#define MAX_CLONE_THREADS 16
+#define MAX_CLONE_JOBS (MAX_CLONE_THREADS * 2) // a job per subtree at the first depth of numThreads nodes or more.
+
+#if defined(__GNUC__)
+#define PREFETCH(address) __builtin_prefetch(address)
+#else
+#define PREFETCH(address) ((void) (address))
+#endif
+
+/**
+ * a counting Bloom filter split to blocks of one cache line. all the probes of an item fall in the
+ * same block. counters which reach BLOOM_MAX_COUNT are never decremented again.
+ */
+typedef struct BloomFilter
+{
+	unsigned char *counters;
+	long unsigned blockMask;
+	HashFunc hashFunc;
+} BloomFilter;
+
+/**
+ * a direct mapped cache of items found by RBTreeContains, in front of the tree. an entry is a
+ * pointer to an item of the tree, so it is removed when its item is deleted.
+ */
+typedef struct HotCache
+{
+	const void **slots;
+	long unsigned mask;
+	HashFunc hashFunc;
+	long unsigned hits;
+	long unsigned misses;
+} HotCache;
+
+/**
+ * an entry of the hash index: the node of an item and the mixed hash of the item (kept so growing
+ * and probing do not call the hash function again). empty entries have no node.
+ */
+typedef struct HashEntry
+{
+	unsigned long long hash;
+	Node *node;
+} HashEntry;
+
+/**
+ * an open addressing (linear probing) table from the items of the tree to their nodes. it is at
+ * most 3/4 full, and deletions shift the following entries back instead of leaving tombstones.
+ */
+typedef struct HashIndex
+{
+	HashEntry *entries;
+	long unsigned mask;
+	long unsigned used;
+	HashFunc hashFunc;
+} HashIndex;
+
+/**
+ * nodes allocated together in one array, in in order of the tree. the nodes of a block are never
+ * freed one by one, the block is freed when none of its nodes is in the tree anymore.
+ */
+typedef struct NodeBlock
+{
+	struct NodeBlock *next;
+	Node *nodes;
+	long unsigned capacity;
+	long unsigned live;
+} NodeBlock;
+
+/**
+ * a part of the nodes of a tree which one thread copies in RBTreeCloneParallel: the subtree of
+ * source is copied in pre order to the nodes of the block from first on, and its root is hanged on
+ * link.
+ */
+typedef struct CloneJob
+{
+	const RBTree *tree;
+	RBTree *clone;
+	NodeBlock *block;
+	CopyFunc copyFunc;
+	const struct Node *source;
+	struct Node *parent;
+	struct Node **link;
+	long unsigned first;
+	long unsigned next;
+	long unsigned size;
+	int failed;
+} CloneJob;
+
+/**
+ * the state of an incremental compaction: the nodes up to cursor (in order) were relocated to the
+ * first filled slots of the block.
+ */
+typedef struct Compaction
+{
+	NodeBlock *block;
+	long unsigned filled;
+	Node *cursor;
+} Compaction;
+
+/**
+ * the change a batch makes to one item: the node of the item is removed (if the item was in the
+ * tree and the batch removed it or replaced it with an item it inserted), and a new node is hanged
+ * with the item the batch inserted (if the last insert of the item was not undone).
+ */
+typedef struct BatchChange
+{
+	Node *old;
+	void *data;
+	Node *node;
+} BatchChange;
+
+/**
+ * a batch resolved against a tree: the outcome of every operation and the changes in the order of
+ * their items, with their new nodes allocated.
+ */
+struct PreparedBatch
+{
+	RBTree *tree;
+	const BatchOp *ops;
+	long unsigned n;
+	unsigned char *status; // BATCH_OP_FAILED, BATCH_OP_APPLIED or BATCH_OP_UNDONE for every operation.
+	BatchChange *changes;
+	long unsigned numChanges;
+	Node **merged; // room for the nodes of the tree and the new nodes if the batch rebuilds the tree.
+};
+
+/**
+ * responsible on the third delete case
+ * @param tree the tree
+ * @param delete the node to delete
+ * @param parent the parent of the node to delete
+ * @param brother the brother of the node to delete
+ */
+void deleteCase3(const RBTree *tree, Node* delete, Node* parent, Node* brother);
+
+/**
+ * ends the compaction, freeing its block if all its nodes were deleted meanwhile
+ * @param tree the tree
+ */
+void endCompaction(RBTree *tree);
+
+/**
+ * mixes the bits of a hash so that weak user hashes still spread over all the blocks
+ * @param hash the hash
+ * @return the mixed hash
+ */
+unsigned long long mixHash(unsigned long hash)
+{
+	unsigned long long mixed = hash;
+	mixed ^= mixed >> 33;
+	mixed *= 0xff51afd7ed558ccdULL;
+	mixed ^= mixed >> 33;
+	mixed *= 0xc4ceb9fe1a85ec53ULL;
+	mixed ^= mixed >> 33;
+	return mixed;
+}
+
+/**
+ * finds the block of an item and the counters it uses in it
+ * @param bloom the filter
+ * @param data the item
+ * @param probes where to write the indices of the counters in the block
+ * @return pointer to the block
+ */
+unsigned char *bloomBlock(const BloomFilter *bloom, const void *data, unsigned *probes)
+{
+	unsigned long long hash = mixHash(bloom->hashFunc(data));
+	for(int i = 0; i < BLOOM_PROBES; i++)
+	{
+		probes[i] = (unsigned) (hash >> (6 * i)) & (BLOOM_BLOCK_SIZE - 1);
+	}
+	long unsigned block = (long unsigned) (hash >> 32) & bloom->blockMask;
+	return bloom->counters + block * BLOOM_BLOCK_SIZE;
+}
+
+/**
+ * adds an item to the filter
+ * @param bloom the filter
+ * @param data the item
+ */
+void bloomAdd(BloomFilter *bloom, const void *data)
+{
+	unsigned probes[BLOOM_PROBES];
+	unsigned char* block = bloomBlock(bloom, data, probes);
+	for(int i = 0; i < BLOOM_PROBES; i++)
+	{
+		if(block[probes[i]] < BLOOM_MAX_COUNT)
+		{
+			block[probes[i]]++;
+		}
+	}
+}
+
+/**
+ * removes an item which was added to the filter
+ * @param bloom the filter
+ * @param data the item
+ */
+void bloomRemove(BloomFilter *bloom, const void *data)
+{
+	unsigned probes[BLOOM_PROBES];
+	unsigned char* block = bloomBlock(bloom, data, probes);
+	for(int i = 0; i < BLOOM_PROBES; i++)
+	{
+		if(block[probes[i]] < BLOOM_MAX_COUNT)
+		{
+			block[probes[i]]--;
+		}
+	}
+}
+
+/**
+ * checks whether an item may be in the filter
+ * @param bloom the filter
+ * @param data the item
+ * @return 0 if the item is surely not in the filter, 1 if it may be
+ */
+int bloomMayContain(const BloomFilter *bloom, const void *data)
+{
+	unsigned probes[BLOOM_PROBES];
+	const unsigned char* block = bloomBlock(bloom, data, probes);
+	for(int i = 0; i < BLOOM_PROBES; i++)
+	{
+		if(block[probes[i]] == 0)
+		{
+			return FAIL;
+		}
+	}
+	return SUCCESS;
+}
+
+/**
+ * finds the slot of an item in the cache
+ * @param cache the cache
+ * @param data the item
+ * @return pointer to the slot
+ */
+const void **hotCacheSlot(const HotCache *cache, const void *data)
+{
+	return cache->slots + (mixHash(cache->hashFunc(data)) & cache->mask);
+}
+
+/**
+ * removes an item from the cache if it is cached
+ * @param cache the cache
+ * @param data the item
+ */
+void hotCacheInvalidate(HotCache *cache, const void *data)
+{
+	const void** slot = hotCacheSlot(cache, data);
+	if(*slot == data)
+	{
+		*slot = NULL;
+	}
+}
+
+/**
+ * ForEach function that adds an item of the tree to the filter
+ * @param object the item
+ * @param args pointer to the filter
+ * @return 1
+ */
+int bloomAddItem(const void *object, void *args)
+{
+	bloomAdd((BloomFilter *) args, object);
+	return SUCCESS;
+}
+
+/**
+ * RBAllocator alloc function of the default allocator
+ * @param size the size to allocate
+ * @param context unused
+ * @return pointer to the allocated memory, NULL on failure
+ */
+void *defaultAlloc(size_t size, void *context)
+{
+	(void) context;
+	return malloc(size);
+}
+
+/**
+ * RBAllocator free function of the default allocator
+ * @param memory the memory to free
+ * @param context unused
+ */
+void defaultFree(void *memory, void *context)
+{
+	(void) context;
+	free(memory);
+}
+
+/**
+ * allocates memory with the allocator of the tree
+ * @param tree the tree
+ * @param size the size to allocate
+ * @return pointer to the allocated memory, NULL on failure
+ */
+void *treeAlloc(const RBTree *tree, size_t size)
+{
+	return tree->allocator.alloc(size, tree->allocator.context);
+}
+
+/**
+ * frees memory with the allocator of the tree. allocators without a free function release all
+ * their memory at once, so nothing is done.
+ * @param tree the tree
+ * @param memory the memory to free
+ */
+void treeFree(const RBTree *tree, void *memory)
+{
+	if(tree->allocator.free != NULL)
+	{
+		tree->allocator.free(memory, tree->allocator.context);
+	}
+}
+
+/**
+ * the size of a node of the tree, with its key buffer and the slot of its value in a map
+ * @param tree the tree
+ * @return the size
+ */
+size_t nodeSize(const RBTree *tree)
+{
+	return sizeof(Node) + tree->inlineSize + (tree->valueFreeFunc != NULL ? sizeof(void *) : 0);
+}
+
+/**
+ * finds the slot of the value of a node of a map, after the node and its key buffer
+ * @param tree the map
+ * @param node the node
+ * @return pointer to the slot
+ */
+void **valueSlot(const RBTree *tree, Node *node)
+{
+	return (void **) ((char *) (node + 1) + tree->inlineSize);
+}
+
+/**
+ * finds a node of a block by its index, the nodes of a block are nodeSize apart
+ * @param tree the tree
+ * @param block the block
+ * @param i the index
+ * @return pointer to the node
+ */
+Node *blockNode(const RBTree *tree, const NodeBlock *block, long unsigned i)
+{
+	return (Node *) ((char *) block->nodes + i * nodeSize(tree));
+}
+
+/**
+ * checks whether a node is one of the nodes of a block
+ * @param tree the tree
+ * @param block the block
+ * @param node the node
+ * @return 1 if the node is in the block, else 0
+ */
+int inBlock(const RBTree *tree, const NodeBlock *block, const Node *node)
+{
+	return node >= block->nodes && node < blockNode(tree, block, block->capacity);
+}
+
+/**
+ * checks whether the data of a node is kept in the key buffer of the node
+ * @param tree the tree
+ * @param node the node
+ * @return 1 if the data is inline, else 0
+ */
+int isInline(const RBTree *tree, const Node *node)
+{
+	return tree->inlineSize > 0 && node->data == (const void *) (node + 1);
+}
+
+/**
+ * unlinks a block from the tree and frees it
+ * @param tree the tree
+ * @param block the block
+ */
+void freeBlock(RBTree *tree, NodeBlock *block)
+{
+	NodeBlock** link = &tree->blocks;
+	while(*link != block)
+	{
+		link = &(*link)->next;
+	}
+	*link = block->next;
+	treeFree(tree, block->nodes);
+	treeFree(tree, block);
+}
+
+/**
+ * frees the memory of a node which is not in the tree anymore. nodes of a block only release
+ * their block once it is empty (unless a compaction is still filling it).
+ * @param tree the tree
+ * @param node the node
+ */
+void releaseNode(RBTree *tree, Node *node)
+{
+	for(NodeBlock* block = tree->blocks; block != NULL; block = block->next)
+	{
+		if(inBlock(tree, block, node))
+		{
+			block->live--;
+			if(block->live == 0 && (tree->compaction == NULL || tree->compaction->block != block))
+			{
+				freeBlock(tree, block);
+			}
+			return;
+		}
+	}
+	treeFree(tree, node);
+}
+
+/**
+ * frees an item with the FreeFunc of the tree
+ * @param tree the tree
+ * @param data the item
+ */
+void freeData(const RBTree *tree, void *data)
+{
+	if(tree->contextFreeFunc != NULL)
+	{
+		tree->contextFreeFunc(data, tree->allocator.context);
+	}
+	else if(tree->freeFunc != NULL)
+	{
+		tree->freeFunc(data);
+	}
+}
+
+/**
+ * frees the hash index of the tree, the lookups descend the tree from now on
+ * @param tree the tree
+ */
+void freeHashIndex(RBTree *tree)
+{
+	if(tree->hashIndex != NULL)
+	{
+		treeFree(tree, tree->hashIndex->entries);
+		treeFree(tree, tree->hashIndex);
+		tree->hashIndex = NULL;
+	}
+}
+
+/**
+ * finds the node of an item by the hash index
+ * @param tree the tree, it must have an index
+ * @param data the item
+ * @return the node of the item, NULL if it is not in the tree
+ */
+Node* hashIndexFind(const RBTree *tree, const void *data)
+{
+	const HashIndex* index = tree->hashIndex;
+	unsigned long long hash = mixHash(index->hashFunc(data));
+	long unsigned i = (long unsigned) hash & index->mask;
+	while(index->entries[i].node != NULL)
+	{
+		if(index->entries[i].hash == hash && tree->compFunc(index->entries[i].node->data, data) == 0)
+		{
+			return index->entries[i].node;
+		}
+		i = (i + 1) & index->mask;
+	}
+	return NULL;
+}
+
+/**
+ * finds the entry of a node which is in the index
+ * @param index the index
+ * @param node the node
+ * @return pointer to the entry, NULL if the node is not in the index
+ */
+HashEntry *hashIndexEntry(const HashIndex *index, const Node *node)
+{
+	long unsigned i = (long unsigned) mixHash(index->hashFunc(node->data)) & index->mask;
+	while(index->entries[i].node != NULL)
+	{
+		if(index->entries[i].node == node)
+		{
+			return index->entries + i;
+		}
+		i = (i + 1) & index->mask;
+	}
+	return NULL;
+}
+
+/**
+ * puts an entry in the first empty slot of its probe sequence
+ * @param index the index
+ * @param hash the mixed hash of the item
+ * @param node the node of the item
+ */
+void hashIndexPlace(HashIndex *index, unsigned long long hash, Node *node)
+{
+	long unsigned i = (long unsigned) hash & index->mask;
+	while(index->entries[i].node != NULL)
+	{
+		i = (i + 1) & index->mask;
+	}
+	index->entries[i].hash = hash;
+	index->entries[i].node = node;
+}
+
+/**
+ * moves the entries of the index to a new table
+ * @param tree the tree
+ * @param capacity the number of entries of the new table, a power of 2
+ * @return 0 on failure (the index is not changed), 1 on success
+ */
+int hashIndexResize(RBTree *tree, long unsigned capacity)
+{
+	HashIndex* index = tree->hashIndex;
+	HashEntry* entries = (HashEntry *) treeAlloc(tree, sizeof(HashEntry) * capacity);
+	if(entries == NULL)
+	{
+		return FAIL;
+	}
+	for(long unsigned i = 0; i < capacity; i++)
+	{
+		entries[i].node = NULL;
+	}
+	HashEntry* old = index->entries;
+	long unsigned oldCapacity = index->mask + 1;
+	index->entries = entries;
+	index->mask = capacity - 1;
+	if(old != NULL)
+	{
+		for(long unsigned i = 0; i < oldCapacity; i++)
+		{
+			if(old[i].node != NULL)
+			{
+				hashIndexPlace(index, old[i].hash, old[i].node);
+			}
+		}
+		treeFree(tree, old);
+	}
+	return SUCCESS;
+}
+
+/**
+ * adds a node to the hash index, growing it if it gets too full. if it cannot grow it is dropped.
+ * @param tree the tree
+ * @param node the node
+ */
+void hashIndexAdd(RBTree *tree, Node *node)
+{
+	HashIndex* index = tree->hashIndex;
+	if((index->used + 1) * 4 > (index->mask + 1) * 3 && hashIndexResize(tree, (index->mask + 1) * 2) == 0)
+	{
+		freeHashIndex(tree);
+		return;
+	}
+	hashIndexPlace(index, mixHash(index->hashFunc(node->data)), node);
+	index->used++;
+}
+
+/**
+ * removes a node from the hash index. the entries after it in the same run are shifted back if
+ * their probe sequence passes through the freed slot, so no lookup skips over a hole.
+ * @param index the index
+ * @param node the node
+ */
+void hashIndexRemove(HashIndex *index, const Node *node)
+{
+	HashEntry* entry = hashIndexEntry(index, node);
+	if(entry == NULL)
+	{
+		return;
+	}
+	long unsigned hole = (long unsigned) (entry - index->entries);
+	long unsigned i = (hole + 1) & index->mask;
+	while(index->entries[i].node != NULL)
+	{
+		long unsigned home = (long unsigned) index->entries[i].hash & index->mask;
+		// the entry may fill the hole only if the hole is between its home slot and its slot.
+		if(((i - home) & index->mask) >= ((i - hole) & index->mask))
+		{
+			index->entries[hole] = index->entries[i];
+			hole = i;
+		}
+		i = (i + 1) & index->mask;
+	}
+	index->entries[hole].node = NULL;
+	index->used--;
+}
+
+/**
+ * adds the nodes of a subtree to the hash index, stops if the index was dropped
+ * @param tree the tree
+ * @param node the root of the subtree
+ */
+void hashIndexAddSubtree(RBTree *tree, Node *node)
+{
+	while(node != NULL && tree->hashIndex != NULL)
+	{
+		hashIndexAddSubtree(tree, node->left);
+		if(tree->hashIndex != NULL)
+		{
+			hashIndexAdd(tree, node);
+		}
+		node = node->right;
+	}
+}
+
+/**
+ * constructs a new RBTree whose nodes are allocated by the given allocator.
+ * @param compFunc: a function to compare two items.
+ * @param freeFunc: a function to free an item, it gets the context of the allocator (may be NULL if
+ * the tree does not own its items).
+ * @param allocator: the allocator, it is copied to the tree (the context is not).
+ * @return: pointer to the new tree, NULL on failure.
+ */
+RBTree *newRBTreeWithAllocator(CompareFunc compFunc, ContextFreeFunc freeFunc, const RBAllocator *allocator)
+{
+	if(allocator == NULL || allocator->alloc == NULL)
+	{
+		return NULL;
+	}
+	RBTree* newTree = (RBTree *) allocator->alloc(sizeof(RBTree), allocator->context);
+	if(newTree == NULL)
+	{
+		return NULL;
+	}
+	newTree->allocator = *allocator;
+	newTree->contextFreeFunc = freeFunc;
+	newTree->compFunc = compFunc;
+	newTree->freeFunc = NULL;
+	newTree->size = 0;
+	newTree->root = NULL;
+	newTree->bloom = NULL;
+	newTree->hotCache = NULL;
+	newTree->hashIndex = NULL;
+	newTree->counted = 0;
+	newTree->valueFreeFunc = NULL;
+	newTree->blocks = NULL;
+	newTree->compaction = NULL;
+	newTree->reaping = NULL;
+	newTree->inlineSize = 0;
+	newTree->augmentFunc = NULL;
+	return newTree;
+}
+
+/**
+ * constructs a new RBTree with the given CompareFunc.
+ * comp: a function two compare two variables.
+ */
+RBTree *newRBTree(CompareFunc compFunc, FreeFunc freeFunc)
+{
+	RBAllocator allocator;
+	allocator.alloc = defaultAlloc;
+	allocator.free = defaultFree;
+	allocator.context = NULL;
+	RBTree* newTree = newRBTreeWithAllocator(compFunc, NULL, &allocator);
+	if(newTree != NULL)
+	{
+		newTree->freeFunc = freeFunc;
+	}
+	return newTree;
+}
+
+/**
+ * constructs a new counted RBTree (a multiset): inserting an item which is already in the tree
+ * increments its counter, and deleting it decrements the counter.
+ * @param compFunc: a function to compare two items.
+ * @param freeFunc: a function to free an item.
+ * @return: pointer to the new tree, NULL on failure.
+ */
+RBTree *newCountedRBTree(CompareFunc compFunc, FreeFunc freeFunc)
+{
+	RBTree* newTree = newRBTree(compFunc, freeFunc);
+	if(newTree != NULL)
+	{
+		newTree->counted = 1;
+	}
+	return newTree;
+}
+
+/**
+ * constructs a new map: a tree of keys where every node also holds a value.
+ * @param compFunc: a function to compare two keys.
+ * @param keyFreeFunc: a function to free a key.
+ * @param valueFreeFunc: a function to free a value.
+ * @return: pointer to the new map, NULL on failure.
+ */
+RBTree *newRBMap(CompareFunc compFunc, FreeFunc keyFreeFunc, FreeFunc valueFreeFunc)
+{
+	if(valueFreeFunc == NULL)
+	{
+		return NULL;
+	}
+	RBTree* newMap = newRBTree(compFunc, keyFreeFunc);
+	if(newMap != NULL)
+	{
+		newMap->valueFreeFunc = valueFreeFunc;
+	}
+	return newMap;
+}
+
+/**
+ * constructs a new tree of strings whose nodes have a buffer for short keys.
+ * @param compFunc: a function to compare two strings.
+ * @param freeFunc: a function to free a string.
+ * @param inlineSize: the size of the buffer of every node, at most MAX_INLINE_SIZE.
+ * @return: pointer to the new tree, NULL on failure.
+ */
+RBTree *newInlineStringRBTree(CompareFunc compFunc, FreeFunc freeFunc, size_t inlineSize)
+{
+	// the buffer keeps the nodes of a block aligned.
+	inlineSize = (inlineSize + sizeof(void *) - 1) / sizeof(void *) * sizeof(void *);
+	if(inlineSize == 0 || inlineSize > MAX_INLINE_SIZE)
+	{
+		return NULL;
+	}
+	RBTree* newTree = newRBTree(compFunc, freeFunc);
+	if(newTree != NULL)
+	{
+		newTree->inlineSize = inlineSize;
+	}
+	return newTree;
+}
+
+/**
+ * check whether the tree RBTreeContains this item.
+ * @param tree: the tree to add an item to.
+ * @param data: item to check.
+ * @return: 0 if the item is not in the tree, other if it is.
+ */
+int RBTreeContains(const RBTree *tree, const void *data)
+{
+	if(tree == NULL || data == NULL)
+	{
+		return FAIL;
+	}
+	if(tree->bloom != NULL && bloomMayContain(tree->bloom, data) == 0)
+	{
+		return FAIL;
+	}
+	if(tree->hashIndex != NULL)
+	{
+		return hashIndexFind(tree, data) != NULL;
+	}
+	const void** slot = NULL;
+	if(tree->hotCache != NULL)
+	{
+		slot = hotCacheSlot(tree->hotCache, data);
+		if(*slot != NULL && tree->compFunc(*slot, data) == 0)
+		{
+			tree->hotCache->hits++;
+			return SUCCESS;
+		}
+		tree->hotCache->misses++;
+	}
+	Node* runner = tree->root;
+	while(runner != NULL)
+	{
+		int res = tree->compFunc(runner->data, data);
+		if(res == 0)
+		{
+			if(slot != NULL)
+			{
+				*slot = runner->data;
+			}
+			return SUCCESS;
+		}
+		if(res > 0)
+		{
+			runner = runner->left;
+		}
+		else
+		{
+			runner = runner->right;
+		}
+	}
+	return FAIL;
+}
+
+/**
+ * advances one group of lookups in lockstep. every round first prefetches the data of the nodes
+ * the lookups are standing on (the nodes were prefetched in the previous round), and only then
+ * compares, so the cache misses of the whole group overlap instead of being paid one by one.
+ * @param tree the tree
+ * @param keys the keys of the group
+ * @param count the number of keys in the group
+ * @param results where to write the result of each key
+ */
+void containsGroup(const RBTree *tree, const void *const *keys, long unsigned count, int *results)
+{
+	Node* cursors[BATCH_GROUP_SIZE];
+	long unsigned active = 0;
+	for(long unsigned i = 0; i < count; i++)
+	{
+		results[i] = FAIL;
+		cursors[i] = keys[i] == NULL ? NULL : tree->root;
+		if(cursors[i] != NULL)
+		{
+			PREFETCH(cursors[i]);
+			active++;
+		}
+	}
+	while(active > 0)
+	{
+		for(long unsigned i = 0; i < count; i++)
+		{
+			if(cursors[i] != NULL)
+			{
+				PREFETCH(cursors[i]->data);
+			}
+		}
+		for(long unsigned i = 0; i < count; i++)
+		{
+			Node* runner = cursors[i];
+			if(runner == NULL)
+			{
+				continue;
+			}
+			int res = tree->compFunc(runner->data, keys[i]);
+			if(res == 0)
+			{
+				results[i] = SUCCESS;
+				runner = NULL;
+			}
+			else if(res > 0)
+			{
+				runner = runner->left;
+			}
+			else
+			{
+				runner = runner->right;
+			}
+			cursors[i] = runner;
+			if(runner == NULL)
+			{
+				active--;
+			}
+			else
+			{
+				PREFETCH(runner);
+			}
+		}
+	}
+}
+
+/**
+ * check for many items at once whether the tree contains them.
+ * @param tree: the tree to search in.
+ * @param keys: the items to check.
+ * @param n: the number of items.
+ * @param results: an array of n ints, results[i] is set to 0 if keys[i] is not in the tree, other if it is.
+ * @return: 0 on failure, other on success.
+ */
+int RBTreeContainsBatch(const RBTree *tree, const void *const *keys, long unsigned n, int *results)
+{
+	if(tree == NULL || keys == NULL || results == NULL)
+	{
+		return FAIL;
+	}
+	for(long unsigned start = 0; start < n; start += BATCH_GROUP_SIZE)
+	{
+		long unsigned count = n - start;
+		if(count > BATCH_GROUP_SIZE)
+		{
+			count = BATCH_GROUP_SIZE;
+		}
+		containsGroup(tree, keys + start, count, results + start);
+	}
+	return SUCCESS;
+}
+
+/**
+ * frees the data of a node (and its value if the tree is a map)
+ * @param tree the tree
+ * @param treeNode the node
+ */
+void freePayload(const RBTree *tree, Node* treeNode)
+{
+	if(isInline(tree, treeNode) == 0)
+	{
+		freeData(tree, treeNode->data);
+	}
+	if(tree->valueFreeFunc != NULL)
+	{
+		tree->valueFreeFunc(*valueSlot(tree, treeNode));
+	}
+}
+
+/**
+ * updates the tree after a node was hanged on it
+ * @param tree the tree
+ * @param node the new node
+ */
+void nodeAdded(RBTree *tree, Node *node)
+{
+	if(tree->bloom != NULL)
+	{
+		bloomAdd(tree->bloom, node->data);
+	}
+	if(tree->hashIndex != NULL)
+	{
+		hashIndexAdd(tree, node);
+	}
+	tree->size++;
+}
+
+/**
+ * updates the tree after a node was unlinked from it, and frees the node and its data
+ * @param tree the tree
+ * @param node the removed node
+ */
+void discardNode(RBTree *tree, Node *node)
+{
+	if(tree->bloom != NULL)
+	{
+		bloomRemove(tree->bloom, node->data);
+	}
+	if(tree->hotCache != NULL)
+	{
+		hotCacheInvalidate(tree->hotCache, node->data);
+	}
+	if(tree->hashIndex != NULL)
+	{
+		hashIndexRemove(tree->hashIndex, node);
+	}
+	freePayload(tree, node);
+	releaseNode(tree, node);
+	tree->size--;
+}
+
+/**
+ * frees nodes and their data without recursion: left children are rotated up until the top node
+ * has no left child, then it is freed and its right child becomes the top. the parent pointers are
+ * not maintained, the nodes are not in the tree anymore.
+ * @param tree the tree
+ * @param pending the top of the nodes to free, updated to the nodes which are left
+ * @param budget the maximal number of nodes to free, 0 for no limit
+ */
+void freeNodes(RBTree *tree, Node **pending, long unsigned budget)
+{
+	Node* top = *pending;
+	long unsigned freed = 0;
+	while(top != NULL && (budget == 0 || freed < budget))
+	{
+		if(top->left != NULL)
+		{
+			Node* left = top->left;
+			top->left = left->right;
+			left->right = top;
+			top = left;
+		}
+		else
+		{
+			Node* right = top->right;
+			freePayload(tree, top);
+			releaseNode(tree, top);
+			top = right;
+			freed++;
+		}
+	}
+	*pending = top;
+}
+
+/**
+ * checks whether freeing the nodes of the tree does anything. a tree which does not own its items
+ * (e.g. strings of a StringArena) and whose allocator releases all its memory at once does not need
+ * to visit its nodes to be freed.
+ * @param tree the tree
+ * @return 1 if the nodes must be visited to free them, else 0
+ */
+int nodesNeedFree(const RBTree *tree)
+{
+	return tree->allocator.free != NULL || tree->freeFunc != NULL || tree->contextFreeFunc != NULL ||
+			tree->valueFreeFunc != NULL;
+}
+
+/**
+ * free all memory of the data structure.
+ * @param tree: pointer to the tree to free.
+ */
+void freeRBTree(RBTree **tree)
+{
+	if(*tree != NULL)
+	{
+		if(nodesNeedFree(*tree))
+		{
+			freeNodes(*tree, &(*tree)->root, 0);
+			freeNodes(*tree, &(*tree)->reaping, 0);
+		}
+		if((*tree)->bloom != NULL)
+		{
+			treeFree(*tree, (*tree)->bloom->counters);
+			treeFree(*tree, (*tree)->bloom);
+		}
+		if((*tree)->hotCache != NULL)
+		{
+			treeFree(*tree, (*tree)->hotCache->slots);
+			treeFree(*tree, (*tree)->hotCache);
+		}
+		freeHashIndex(*tree);
+		if((*tree)->compaction != NULL)
+		{
+			treeFree(*tree, (*tree)->compaction);
+			(*tree)->compaction = NULL;
+		}
+		while((*tree)->blocks != NULL)
+		{
+			freeBlock(*tree, (*tree)->blocks);
+		}
+		treeFree(*tree, *tree);
+	}
+	*tree = NULL;
+}
+
+/**
+ * free the tree in bounded steps. the first call detaches all the nodes from the tree in O(1) (the
+ * tree is empty from then on and must not be changed), and every call frees at most budget nodes.
+ * @param tree: pointer to the tree to free, set to NULL when all its memory was freed.
+ * @param budget: the maximal number of nodes to free in this call, 0 for no limit.
+ * @return: 0 on failure, other on success.
+ */
+int freeRBTreeIncremental(RBTree **tree, long unsigned budget)
+{
+	if(tree == NULL || *tree == NULL)
+	{
+		return FAIL;
+	}
+	if((*tree)->compaction != NULL)
+	{
+		endCompaction(*tree);
+	}
+	if((*tree)->root != NULL)
+	{
+		(*tree)->reaping = (*tree)->root;
+		(*tree)->root = NULL;
+		(*tree)->size = 0;
+		freeHashIndex(*tree);
+	}
+	if(nodesNeedFree(*tree) == 0)
+	{
+		(*tree)->reaping = NULL;
+	}
+	freeNodes(*tree, &(*tree)->reaping, budget);
+	if((*tree)->reaping == NULL)
+	{
+		freeRBTree(tree);
+	}
+	return SUCCESS;
+}
+
+/**
+ * find the location of a given data, comparing once on every level
+ * @param tree the tree
+ * @param data the data
+ * @param lastCompare where to write the result of the last comparison (0 iff the data was found)
+ * @return NULL if the tree is empty, pointer to the node with the data if it is in the tree, else
+ * pointer to the node the data should be hanged on
+ */
+Node* findLocation(const RBTree *tree, const void *data, int *lastCompare)
+{
+	*lastCompare = 1;
+	if(tree == NULL)
+	{
+		return NULL;
+	}
+	Node* runner = tree->root;
+	Node* location = NULL;
+	while(runner != NULL)
+	{
+		location = runner;
+		*lastCompare = tree->compFunc(runner->data, data);
+		if(*lastCompare == 0)
+		{
+			break;
+		}
+		if(*lastCompare > 0)
+		{
+			runner = runner->left;
+		}
+		else
+		{
+			runner = runner->right;
+		}
+	}
+	return location;
+}
+
+/**
+ * finds the node of an item, by the hash index if the tree has one
+ * @param tree the tree
+ * @param data the item
+ * @return the node of the item, NULL if it is not in the tree
+ */
+Node* findNode(const RBTree *tree, const void *data)
+{
+	if(tree->hashIndex != NULL)
+	{
+		return hashIndexFind(tree, data);
+	}
+	int compare = 0;
+	Node* location = findLocation(tree, data, &compare);
+	return compare == 0 ? location : NULL;
+}
+
+/**
+ * inits the values in an allocated node
+ * @param tree the tree
+ * @param newNode the node
+ * @param data the data
+ */
+void fillNode(const RBTree *tree, Node *newNode, void *data)
+{
+	newNode->data = data;
+	if(tree->inlineSize > 0)
+	{
+		const char* string = (const char *) data;
+		size_t length = 0;
+		while(length < tree->inlineSize && string[length] != '\0')
+		{
+			length++;
+		}
+		if(length < tree->inlineSize)
+		{
+			memcpy(newNode + 1, string, length + 1);
+			newNode->data = newNode + 1;
+			freeData(tree, data);
+		}
+	}
+	newNode->color = RED;
+	newNode->count = 1;
+	if(tree->valueFreeFunc != NULL)
+	{
+		*valueSlot(tree, newNode) = NULL;
+	}
+	newNode->left = NULL;
+	newNode->right = NULL;
+	newNode->parent = NULL;
+}
+
+/**
+ * inits the values in the node
+ * @param tree the tree
+ * @param data the data
+ * @return pointer to the new node
+ */
+Node* initNode(const RBTree *tree, void* data)
+{
+	Node* newNode = (Node*) treeAlloc(tree, nodeSize(tree));
+	if(newNode == NULL)
+	{
+		return NULL;
+	}
+	fillNode(tree, newNode, data);
+	return newNode;
+}
+
+/**
+ * finds the uncle
+ * @param parent node's parent
+ * @param grandParent node's grandparent
+ * @return pointer to the uncle node
+ */
+Node* getUncle(const Node* parent, Node* grandParent)
+{
+	if(grandParent->right == parent)
+	{
+		return grandParent->left;
+	}
+	else
+	{
+		return grandParent->right;
+	}
+}
+
+/**
+ * insert case number 3
+ * @param parent node's parent
+ * @param grandParent node's grandparent
+ * @param uncle node's uncle
+ */
+void redFatherRedUncle(Node* parent, Node* grandParent, Node* uncle)
+{
+	parent->color = BLACK;
+	uncle->color = BLACK;
+	grandParent->color = RED;
+}
+
+/**
+ * recomputes the augmented fields of the item of a node from the items of its children
+ * @param tree the tree
+ * @param node the node
+ */
+void augmentNode(const RBTree *tree, Node *node)
+{
+	tree->augmentFunc(node->data, node->left != NULL ? node->left->data : NULL,
+					  node->right != NULL ? node->right->data : NULL);
+}
+
+/**
+ * recomputes the augmented fields of a node and of all the nodes above it, after the items under
+ * them changed
+ * @param tree the tree
+ * @param node the lowest node whose subtree changed (may be NULL)
+ */
+void augmentPath(const RBTree *tree, Node *node)
+{
+	if(tree->augmentFunc == NULL)
+	{
+		return;
+	}
+	for(; node != NULL; node = node->parent)
+	{
+		augmentNode(tree, node);
+	}
+}
+
+/**
+ * recomputes the augmented fields of all the nodes of a subtree, children before their parents
+ * @param tree the tree
+ * @param node the root of the subtree
+ */
+void augmentSubtree(const RBTree *tree, Node *node)
+{
+	if(node != NULL)
+	{
+		augmentSubtree(tree, node->left);
+		augmentSubtree(tree, node->right);
+		augmentNode(tree, node);
+	}
+}
+
+/**
+ * rotates the tree to the right
+ * @param tree the tree
+ * @param newNode the node to rotate
+ */
+void rotateRight(const RBTree *tree, Node* newNode)
+{
+	Node* leftChild = newNode->left;
+	Node* parent = newNode->parent;
+	if(leftChild != NULL)
+	{
+		newNode->left = leftChild->right;
+		leftChild->right = newNode;
+	}
+	else
+	{
+		newNode->left = NULL;
+	}
+	newNode->parent = leftChild;
+	if (newNode->left != NULL)
+	{
+		newNode->left->parent = newNode;
+	}
+	if (parent != NULL)
+	{
+		if (newNode == parent->left)
+		{
+			parent->left = leftChild;
+		}
+		else if (newNode == parent->right)
+		{
+			parent->right = leftChild;
+		}
+	}
+	leftChild->parent = parent;
+	if(tree->augmentFunc != NULL)
+	{
+		augmentNode(tree, newNode);
+		augmentNode(tree, leftChild);
+	}
+}
+
+/**
+ * rotates the tree to the left
+ * @param tree the tree
+ * @param newNode the node to rotate
+ */
+void rotateLeft(const RBTree *tree, Node* newNode)
+{
+	Node* rightChild = newNode->right;
+	Node* parent = newNode->parent;
+	if(rightChild != NULL)
+	{
+		newNode->right = rightChild->left;
+		rightChild->left = newNode;
+	}
+	else
+	{
+		newNode->right = NULL;
+	}
+	newNode->parent = rightChild;
+	if (newNode->right != NULL)
+	{
+		newNode->right->parent = newNode;
+	}
+	if (parent != NULL)
+	{
+		if (newNode == parent->left)
+		{
+			parent->left = rightChild;
+		}
+		else if (newNode == parent->right)
+		{
+			parent->right = rightChild;
+		}
+	}
+	rightChild->parent = parent;
+	if(tree->augmentFunc != NULL)
+	{
+		augmentNode(tree, newNode);
+		augmentNode(tree, rightChild);
+	}
+}
+
+/**
+ * the second step of the 4 insert case
+ * @param tree the tree
+ * @param newNode the node to change
+ */
+void secondStep(const RBTree *tree, Node* newNode)
+{
+	Node* parent = newNode->parent;
+	Node* grandParent = parent->parent;
+	if(newNode == parent->left)
+	{
+		rotateRight(tree, grandParent);
+	}
+	else
+	{
+		rotateLeft(tree, grandParent);
+	}
+	parent->color = BLACK;
+	grandParent->color = RED;
+}
+
+/**
+ * insert case number 3
+ * @param tree the tree
+ * @param newNode the node to insert
+ * @param parent the node's parent
+ * @param grandParent the node's grandparent
+ */
+void redFatherBlackUncle(const RBTree *tree, Node* newNode, Node* parent, Node* grandParent)
+{
+	if(newNode == parent->right && parent == grandParent->left)
+	{
+		rotateLeft(tree, parent);
+		newNode = newNode->left;
+	}
+	else if(newNode == parent->left && parent == grandParent->right)
+	{
+		rotateRight(tree, parent);
+		newNode = newNode->right;
+	}
+	secondStep(tree, newNode);
+}
+
+/**
+ * the main function that responsible on the insert repairs
+ * @param tree the tree
+ * @param parent node's parent
+ * @param newNode the node to insert
+ */
+void insertRepairs(RBTree* tree, Node* parent, Node* newNode)
+{
+	if(parent == NULL)
+	{
+		newNode->color = BLACK;
+	}
+	else if(parent->color == BLACK)
+	{
+		return;
+	}
+	else
+	{
+		Node* grandParent = parent->parent;
+		Node* uncle = getUncle(parent, grandParent);
+		if(uncle == NULL || uncle->color == BLACK)
+		{
+			redFatherBlackUncle(tree, newNode, parent, grandParent);
+		}
+		else
+		{
+			redFatherRedUncle(parent, grandParent, uncle);
+			insertRepairs(tree, grandParent->parent, grandParent);
+		}
+	}
+}
+
+/**
+ * hangs the node on the tree
+ * @param parent the parent of the node
+ * @param newNode the node to hang
+ * @param tree the tree
+ * @param compare the result of comparing the parent's data to the node's data
+ */
+void hangNode(Node* parent, Node* newNode, RBTree *tree, int compare)
+{
+	if(parent == NULL)
+	{
+		tree->root = newNode;
+	}
+	else
+	{
+		newNode->parent = parent;
+		if (compare > 0)
+		{
+			parent->left = newNode;
+		}
+		else
+		{
+			parent->right = newNode;
+		}
+	}
+}
+
+/**
+ * finds the new root after the insert
+ * @param newNode
+ * @return pointer to the root
+ */
+Node* findNewRoot(Node* newNode)
+{
+	while (newNode->parent != NULL)
+	{
+		newNode = newNode->parent;
+	}
+	return newNode;
+}
+
+/**
+ * hangs a new node on the tree and balances it
+ * @param tree the tree
+ * @param parent the node to hang the new node on (from findLocation), NULL if the tree is empty
+ * @param newNode the new node
+ * @param compare the result of comparing the parent's data to the node's data
+ */
+void linkNewNode(RBTree *tree, Node *parent, Node *newNode, int compare)
+{
+	hangNode(parent, newNode, tree, compare);
+	augmentPath(tree, newNode);
+	insertRepairs(tree, parent, newNode);
+	nodeAdded(tree, newNode);
+	tree->root = findNewRoot(newNode);
+}
+
+/**
+ * finds the node of the data, or hangs a new node with the data if it is not in the tree
+ * @param tree the tree
+ * @param data the data
+ * @param found set to 1 if the data was already in the tree, else to 0
+ * @return the node of the data, NULL if a new node could not be allocated
+ */
+Node* findOrInsertNode(RBTree *tree, void *data, int *found)
+{
+	int compare = 0;
+	Node* parent = findLocation(tree, data, &compare);
+	*found = parent != NULL && compare == 0;
+	if(*found)
+	{
+		return parent;
+	}
+	Node* newNode = initNode(tree, data);
+	if(newNode == NULL)
+	{
+		return NULL;
+	}
+	linkNewNode(tree, parent, newNode, compare);
+	return newNode;
+}
+
+/**
+ * checks whether a node is red
+ * @param n the node (may be NULL)
+ * @return 1 if the node is red, 0 if it is black or NULL
+ */
+int isRed(const Node* n)
+{
+	return n != NULL && n->color == RED;
+}
+
+/**
+ * fixes a red node with a red parent, met on the way down. the uncle is black (else both of the
+ * grandparent's children would have been flipped to black on the way down), so one or two
+ * rotations at the grandparent fix it, and the root is updated without walking back up.
+ * @param tree the tree
+ * @param newNode the red node
+ */
+void fixRedParent(RBTree *tree, Node* newNode)
+{
+	Node* parent = newNode->parent;
+	Node* grandParent = parent->parent;
+	if((newNode == parent->left) != (parent == grandParent->left))
+	{
+		if(newNode == parent->left)
+		{
+			rotateRight(tree, parent);
+		}
+		else
+		{
+			rotateLeft(tree, parent);
+		}
+		parent = newNode;
+	}
+	if(parent == grandParent->left)
+	{
+		rotateRight(tree, grandParent);
+	}
+	else
+	{
+		rotateLeft(tree, grandParent);
+	}
+	parent->color = BLACK;
+	grandParent->color = RED;
+	if(parent->parent == NULL)
+	{
+		tree->root = parent;
+	}
+}
+
+/**
+ * finds the node of the data, or hangs a new node with the data if it is not in the tree. the tree
+ * is balanced on the way down: a node with two red children is flipped to red, so when the bottom
+ * is reached the new node can be hanged with at most one local fix and no pass back up.
+ * @param tree the tree
+ * @param data the data
+ * @param found set to 1 if the data was already in the tree, else to 0
+ * @return the node of the data, NULL if a new node could not be allocated
+ */
+Node* findOrInsertNodeTopDown(RBTree *tree, void *data, int *found)
+{
+	Node* parent = NULL;
+	Node* runner = tree->root;
+	int compare = 1;
+	*found = 0;
+	while(runner != NULL)
+	{
+		if(isRed(runner->left) && isRed(runner->right))
+		{
+			runner->color = RED;
+			runner->left->color = BLACK;
+			runner->right->color = BLACK;
+			if(isRed(runner->parent))
+			{
+				fixRedParent(tree, runner);
+			}
+		}
+		compare = tree->compFunc(runner->data, data);
+		if(compare == 0)
+		{
+			*found = 1;
+			break;
+		}
+		parent = runner;
+		runner = compare > 0 ? runner->left : runner->right;
+	}
+	if(*found == 0)
+	{
+		runner = initNode(tree, data);
+		if(runner != NULL)
+		{
+			hangNode(parent, runner, tree, compare);
+			augmentPath(tree, runner);
+			if(isRed(parent))
+			{
+				fixRedParent(tree, runner);
+			}
+			nodeAdded(tree, runner);
+		}
+	}
+	if(tree->root != NULL)
+	{
+		tree->root->color = BLACK;
+	}
+	return runner;
+}
+
+/**
+ * finishes an insert: data which was already in the tree is counted in a counted tree, and
+ * rejected in any other tree
+ * @param tree the tree
+ * @param node the node of the data, NULL if it could not be inserted
+ * @param found 1 if the data was already in the tree
+ * @param data the inserted data
+ * @return 0 on failure, 1 on success
+ */
+int completeInsert(RBTree *tree, Node *node, int found, void *data)
+{
+	if(node == NULL || (found && tree->counted == 0))
+	{
+		return FAIL;
+	}
+	if(found)
+	{
+		node->count++;
+		freeData(tree, data);
+	}
+	return SUCCESS;
+}
+
+/**
+ * add an item to the tree
+ * @param tree: the tree to add an item to.
+ * @param data: item to add to the tree.
+ * @return: 0 on failure, other on success. (if the item is already in the tree - failure, unless
+ * the tree is counted: then its counter is incremented and data is freed with the tree's FreeFunc).
+ */
+int insertToRBTree(RBTree *tree, void *data)
+{
+	if(tree == NULL || data == NULL)
+	{
+		return FAIL;
+	}
+	int found = 0;
+	Node* node = findOrInsertNode(tree, data, &found);
+	return completeInsert(tree, node, found, data);
+}
+
+/**
+ * add an item to the tree, balancing it in a single pass on the way down.
+ * @param tree: the tree to add an item to.
+ * @param data: item to add to the tree.
+ * @return: 0 on failure, other on success. (same as insertToRBTree).
+ */
+int insertToRBTreeTopDown(RBTree *tree, void *data)
+{
+	if(tree == NULL || data == NULL)
+	{
+		return FAIL;
+	}
+	int found = 0;
+	Node* node = findOrInsertNodeTopDown(tree, data, &found);
+	return completeInsert(tree, node, found, data);
+}
+
+/**
+ * put a value in the map. if the key is already in the map its value is replaced in place: the old
+ * value is freed with the map's value FreeFunc and the given key with its key FreeFunc.
+ * @param map: the map.
+ * @param key: the key.
+ * @param value: the value.
+ * @return: 0 on failure, other on success.
+ */
+int RBMapPut(RBTree *map, void *key, void *value)
+{
+	if(map == NULL || key == NULL || map->valueFreeFunc == NULL)
+	{
+		return FAIL;
+	}
+	int found = 0;
+	Node* node = findOrInsertNode(map, key, &found);
+	if(node == NULL)
+	{
+		return FAIL;
+	}
+	if(found)
+	{
+		freeData(map, key);
+		if(*valueSlot(map, node) != value)
+		{
+			map->valueFreeFunc(*valueSlot(map, node));
+		}
+	}
+	*valueSlot(map, node) = value;
+	return SUCCESS;
+}
+
+/**
+ * get the value of a key.
+ * @param map: the map.
+ * @param key: the key.
+ * @return: the value of the key, NULL if the key is not in the map.
+ */
+void *RBMapGet(const RBTree *map, const void *key)
+{
+	if(map == NULL || key == NULL || map->valueFreeFunc == NULL)
+	{
+		return NULL;
+	}
+	if(map->bloom != NULL && bloomMayContain(map->bloom, key) == 0)
+	{
+		return NULL;
+	}
+	Node* location = findNode(map, key);
+	if(location == NULL)
+	{
+		return NULL;
+	}
+	return *valueSlot(map, location);
+}
+
+/**
+ * get the slot of the value of a key, inserting the key with the given value if it is not in the map.
+ * if the key is already in the map, the given key and value are freed with the map's FreeFuncs.
+ * @param map: the map.
+ * @param key: the key.
+ * @param value: the value to insert if the key is not in the map.
+ * @return: pointer to the value in the map, which may be updated in place. NULL on failure.
+ */
+void **RBMapGetOrInsert(RBTree *map, void *key, void *value)
+{
+	if(map == NULL || key == NULL || map->valueFreeFunc == NULL)
+	{
+		return NULL;
+	}
+	int found = 0;
+	Node* node = findOrInsertNode(map, key, &found);
+	if(node == NULL)
+	{
+		return NULL;
+	}
+	if(found)
+	{
+		freeData(map, key);
+		if(value != *valueSlot(map, node))
+		{
+			map->valueFreeFunc(value);
+		}
+	}
+	else
+	{
+		*valueSlot(map, node) = value;
+	}
+	return valueSlot(map, node);
+}
+
+/**
+ * in order walk that passes the value of every key
+ * @param map the map
+ * @param curNode the current node
+ * @param func the func to apply on the nodes
+ * @param args extra args
+ * @return 0 if the func failed, else 1
+ */
+int forEachRBMapHelper(const RBTree *map, Node* curNode, forEachPairFunc func, void *args)
+{
+	if(curNode == NULL)
+	{
+		return SUCCESS;
+	}
+	void* value = map->valueFreeFunc != NULL ? *valueSlot(map, curNode) : NULL;
+	if(forEachRBMapHelper(map, curNode->left, func, args) == 0 || func(curNode->data, value, args) == 0)
+	{
+		return FAIL;
+	}
+	return forEachRBMapHelper(map, curNode->right, func, args);
+}
+
+/**
+ * Activate a function on each key of the map and its value. the order is an ascending order of the
+ * keys. if one of the activations of the function returns 0, the process stops.
+ * @param map: the map.
+ * @param func: the function to activate on all pairs.
+ * @param args: more optional arguments to the function (may be null if the given function support it).
+ * @return: 0 on failure, other on success.
+ */
+int forEachRBMap(const RBTree *map, forEachPairFunc func, void *args)
+{
+	if(map == NULL || func == NULL)
+	{
+		return FAIL;
+	}
+	return forEachRBMapHelper(map, map->root, func, args);
+}
+
+/**
+ * attach a counting Bloom filter to the tree. lookups of items which are not in the tree are then
+ * usually rejected by a few probes of one cache line instead of a full descent.
+ * @param tree: the tree to attach the filter to (the items already in it are added to the filter).
+ * @param hashFunc: a hash function for the items of the tree.
+ * @param expectedItems: the number of items the tree is expected to hold, used to size the filter.
+ * @return: 0 on failure, other on success.
+ */
+int RBTreeAttachBloomFilter(RBTree *tree, HashFunc hashFunc, long unsigned expectedItems)
+{
+	if(tree == NULL || hashFunc == NULL || tree->bloom != NULL)
+	{
+		return FAIL;
+	}
+	if(expectedItems < tree->size)
+	{
+		expectedItems = tree->size;
+	}
+	long unsigned blocks = 1;
+	while(blocks * BLOOM_BLOCK_SIZE < expectedItems * BLOOM_COUNTERS_PER_ITEM)
+	{
+		blocks *= 2;
+	}
+	BloomFilter* bloom = (BloomFilter *) treeAlloc(tree, sizeof(BloomFilter));
+	if(bloom == NULL)
+	{
+		return FAIL;
+	}
+	bloom->counters = (unsigned char *) treeAlloc(tree, blocks * BLOOM_BLOCK_SIZE);
+	if(bloom->counters == NULL)
+	{
+		treeFree(tree, bloom);
+		return FAIL;
+	}
+	memset(bloom->counters, 0, blocks * BLOOM_BLOCK_SIZE);
+	bloom->blockMask = blocks - 1;
+	bloom->hashFunc = hashFunc;
+	forEachRBTree(tree, bloomAddItem, bloom);
+	tree->bloom = bloom;
+	return SUCCESS;
+}
+
+/**
+ *
+ * @param curNode the current node
+ * @param func the func to apply on the nodes
+ * @param args extra args
+ * @return 0 if the func failed, else the value of the run
+ */
+int forEachRBTreeHelper(Node* curNode, forEachFunc func, void *args)
+{
+	if(curNode == NULL)
+	{
+		return FAIL;
+	}
+	if(curNode->left != NULL)
+	{
+		int res = forEachRBTreeHelper(curNode->left, func, args);
+		if(res == 0)
+		{
+			return FAIL;
+		}
+	}
+	int val = func(curNode->data, args);
+	if(curNode->right != NULL)
+	{
+		int res = forEachRBTreeHelper(curNode->right, func, args);
+		if(res == 0)
+		{
+			return FAIL;
+		}
+	}
+	return val;
+}
+
+/**
+ * Activate a function on each item of the tree. the order is an ascending order. if one of the activations of the
+ * function returns 0, the process stops.
+ * @param tree: the tree with all the items.
+ * @param func: the function to activate on all items.
+ * @param args: more optional arguments to the function (may be null if the given function support it).
+ * @return: 0 on failure, other on success.
+ */
+int forEachRBTree(const RBTree *tree, forEachFunc func, void *args)
+{
+	if(tree == NULL)
+	{
+		return FAIL;
+	}
+	if(tree->root == NULL)
+	{
+		return SUCCESS;
+	}
+	int res = forEachRBTreeHelper(tree->root, func, args);
+	if(res == 0)
+	{
+		return FAIL;
+	}
+	return SUCCESS;
+}
+
+/**
+ * attach a small direct mapped cache of found items in front of the tree, so lookups of hot items
+ * skip the descent.
+ * @param tree: the tree to attach the cache to.
+ * @param hashFunc: a hash function for the items of the tree.
+ * @param slots: the number of entries of the cache (rounded up to a power of 2).
+ * @return: 0 on failure, other on success.
+ */
+int RBTreeAttachHotCache(RBTree *tree, HashFunc hashFunc, long unsigned slots)
+{
+	if(tree == NULL || hashFunc == NULL || tree->hotCache != NULL)
+	{
+		return FAIL;
+	}
+	long unsigned capacity = 1;
+	while(capacity < slots)
+	{
+		capacity *= 2;
+	}
+	HotCache* cache = (HotCache *) treeAlloc(tree, sizeof(HotCache));
+	if(cache == NULL)
+	{
+		return FAIL;
+	}
+	cache->slots = (const void **) treeAlloc(tree, sizeof(void *) * capacity);
+	if(cache->slots == NULL)
+	{
+		treeFree(tree, cache);
+		return FAIL;
+	}
+	for(long unsigned i = 0; i < capacity; i++)
+	{
+		cache->slots[i] = NULL;
+	}
+	cache->mask = capacity - 1;
+	cache->hashFunc = hashFunc;
+	cache->hits = 0;
+	cache->misses = 0;
+	tree->hotCache = cache;
+	return SUCCESS;
+}
+
+/**
+ * get the counters of the cache of the tree.
+ * @param tree: the tree.
+ * @param hits: where to write the number of lookups answered by the cache.
+ * @param misses: where to write the number of lookups which descended the tree.
+ * @return: 0 on failure (e.g. the tree has no cache), other on success.
+ */
+int getHotCacheStats(const RBTree *tree, long unsigned *hits, long unsigned *misses)
+{
+	if(tree == NULL || tree->hotCache == NULL || hits == NULL || misses == NULL)
+	{
+		return FAIL;
+	}
+	*hits = tree->hotCache->hits;
+	*misses = tree->hotCache->misses;
+	return SUCCESS;
+}
+
+/**
+ * attach an open addressing hash index from the items of the tree to their nodes, so exact
+ * lookups take O(1) expected.
+ * @param tree: the tree to attach the index to (the items already in it are indexed).
+ * @param hashFunc: a hash function for the items of the tree.
+ * @return: 0 on failure, other on success.
+ */
+int RBTreeAttachHashIndex(RBTree *tree, HashFunc hashFunc)
+{
+	if(tree == NULL || hashFunc == NULL || tree->hashIndex != NULL)
+	{
+		return FAIL;
+	}
+	long unsigned capacity = HASH_INDEX_MIN_CAPACITY;
+	while(capacity * 3 < tree->size * 4)
+	{
+		capacity *= 2;
+	}
+	HashIndex* index = (HashIndex *) treeAlloc(tree, sizeof(HashIndex));
+	if(index == NULL)
+	{
+		return FAIL;
+	}
+	index->entries = NULL;
+	index->mask = 0;
+	index->used = 0;
+	index->hashFunc = hashFunc;
+	tree->hashIndex = index;
+	if(hashIndexResize(tree, capacity) == 0)
+	{
+		treeFree(tree, index);
+		tree->hashIndex = NULL;
+		return FAIL;
+	}
+	hashIndexAddSubtree(tree, tree->root);
+	return tree->hashIndex != NULL;
+}
+
+/**
+ * keep augmented fields in the items of the tree. every operation which changes the shape of the
+ * tree (inserts, deletes and their rotations, batches, rebuilds and splits) recomputes the fields
+ * of the nodes it changed and of the nodes above them, so after every operation the fields of
+ * every item describe its subtree. walks of the tree can then skip whole subtrees by them.
+ * @param tree: the tree, not a tree with key buffers (the fields of the items already in it are
+ * computed).
+ * @param augmentFunc: the function which recomputes the fields of an item.
+ * @return: 0 on failure, other on success.
+ */
+int RBTreeAttachAugment(RBTree *tree, AugmentFunc augmentFunc)
+{
+	if(tree == NULL || augmentFunc == NULL || tree->inlineSize > 0)
+	{
+		return FAIL;
+	}
+	tree->augmentFunc = augmentFunc;
+	augmentSubtree(tree, tree->root);
+	return SUCCESS;
+}
+
+/**
+ * in order walk that passes the counter of every item
+ * @param curNode the current node
+ * @param func the func to apply on the nodes
+ * @param args extra args
+ * @return 0 if the func failed, else 1
+ */
+int forEachCountedHelper(const Node* curNode, forEachCountFunc func, void *args)
+{
+	if(curNode == NULL)
+	{
+		return SUCCESS;
+	}
+	if(forEachCountedHelper(curNode->left, func, args) == 0 || func(curNode->data, curNode->count, args) == 0)
+	{
+		return FAIL;
+	}
+	return forEachCountedHelper(curNode->right, func, args);
+}
+
+/**
+ * Activate a function on each item of the tree and its counter. the order is an ascending order.
+ * if one of the activations of the function returns 0, the process stops.
+ * @param tree: the tree with all the items.
+ * @param func: the function to activate on all items.
+ * @param args: more optional arguments to the function (may be null if the given function support it).
+ * @return: 0 on failure, other on success.
+ */
+int forEachCountedRBTree(const RBTree *tree, forEachCountFunc func, void *args)
+{
+	if(tree == NULL || func == NULL)
+	{
+		return FAIL;
+	}
+	return forEachCountedHelper(tree->root, func, args);
+}
+
+/**
+ * get the counter of an item.
+ * @param tree: the tree to search in.
+ * @param data: the item.
+ * @return: the number of times the item is in the tree (0 if it is not in the tree).
+ */
+long unsigned RBTreeCount(const RBTree *tree, const void *data)
+{
+	if(tree == NULL || data == NULL)
+	{
+		return 0;
+	}
+	if(tree->bloom != NULL && bloomMayContain(tree->bloom, data) == 0)
+	{
+		return 0;
+	}
+	Node* location = findNode(tree, data);
+	if(location == NULL)
+	{
+		return 0;
+	}
+	return location->count;
+}
+
+/**
+ * finds the node which comes after a node in order
+ * @param n the node
+ * @return the next node, NULL if n is the last node
+ */
+Node* nextInOrder(Node* n)
+{
+	if(n->right != NULL)
+	{
+		n = n->right;
+		while(n->left != NULL)
+		{
+			n = n->left;
+		}
+		return n;
+	}
+	while(n->parent != NULL && n->parent->right == n)
+	{
+		n = n->parent;
+	}
+	return n->parent;
+}
+
+/**
+ * finds the node which comes before a node in order
+ * @param n the node
+ * @return the previous node, NULL if n is the first node
+ */
+Node* previousInOrder(Node* n)
+{
+	if(n->left != NULL)
+	{
+		n = n->left;
+		while(n->right != NULL)
+		{
+			n = n->right;
+		}
+		return n;
+	}
+	while(n->parent != NULL && n->parent->left == n)
+	{
+		n = n->parent;
+	}
+	return n->parent;
+}
+
+/**
+ * finds the successor of the node
+ * @param n the node
+ * @return the successor
+ */
+Node* findSuccessor(Node* n)
+{
+	if(n->left == NULL)
+	{
+		return n;
+	}
+	else
+	{
+		return findSuccessor(n->left);
+	}
+}
+
+/**
+ * swaps the data of two nodes of a tree with key buffers: inline data is copied to the buffer of
+ * the other node. cached pointers to inline data would now point to the other item, so they are
+ * removed from the hot cache first.
+ * @param tree the tree
+ * @param first the first node
+ * @param second the second node
+ */
+void swapInlineData(RBTree *tree, Node* first, Node* second)
+{
+	if(tree->hotCache != NULL)
+	{
+		hotCacheInvalidate(tree->hotCache, first->data);
+		hotCacheInvalidate(tree->hotCache, second->data);
+	}
+	char temp[MAX_INLINE_SIZE];
+	void* firstData = first->data;
+	int firstInline = isInline(tree, first);
+	if(firstInline)
+	{
+		memcpy(temp, first + 1, tree->inlineSize);
+	}
+	if(isInline(tree, second))
+	{
+		memcpy(first + 1, second + 1, tree->inlineSize);
+		first->data = first + 1;
+	}
+	else
+	{
+		first->data = second->data;
+	}
+	if(firstInline)
+	{
+		memcpy(second + 1, temp, tree->inlineSize);
+		second->data = second + 1;
+	}
+	else
+	{
+		second->data = firstData;
+	}
+}
+
+/**
+ * swaps the data (and the counters) of two nodes, and their entries in the hash index
+ * @param tree the tree
+ * @param first the first node
+ * @param second the second node
+ */
+void swapPayload(RBTree *tree, Node* first, Node* second)
+{
+	if(first == second)
+	{
+		return;
+	}
+	if(tree->hashIndex != NULL)
+	{
+		HashEntry* firstEntry = hashIndexEntry(tree->hashIndex, first);
+		HashEntry* secondEntry = hashIndexEntry(tree->hashIndex, second);
+		firstEntry->node = second;
+		secondEntry->node = first;
+	}
+	if(tree->inlineSize > 0)
+	{
+		swapInlineData(tree, first, second);
+	}
+	else
+	{
+		void* temp = first->data;
+		first->data = second->data;
+		second->data = temp;
+	}
+	if(tree->valueFreeFunc != NULL)
+	{
+		void* tempValue = *valueSlot(tree, first);
+		*valueSlot(tree, first) = *valueSlot(tree, second);
+		*valueSlot(tree, second) = tempValue;
+	}
+	unsigned tempCount = first->count;
+	first->count = second->count;
+	second->count = tempCount;
+}
+
+/**
+ * changes the data of the node to delete with his successor
+ * @param tree the tree
+ * @param deleteNode the node to delete
+ * @return the successor node
+ */
+Node* changeWithSuccessor(RBTree *tree, Node* deleteNode)
+{
+	Node* successor = findSuccessor(deleteNode->right);
+	swapPayload(tree, deleteNode, successor);
+	return successor;
+}
+
+/**
+ * finds the child of the node
+ * @param n the node
+ * @return the child
+ */
+Node* findChild(Node* n)
+{
+	if(n->left != NULL)
+	{
+		return n->left;
+	}
+	else if(n->right != NULL)
+	{
+		return n->right;
+	}
+	return NULL;
+}
+
+/**
+ * finds the brother of the node
+ * @param n the node
+ * @return the brother
+ */
+Node* findBrother(Node* n)
+{
+	if(n->parent == NULL)
+	{
+		return NULL;
+	}
+	if(n->parent->left == n)
+	{
+		return n->parent->right;
+	}
+	return n->parent->left;
+}
+
+/**
+ * executes delete case number 1
+ * @param delete the node to delete
+ * @param parent the parent of the node to delete
+ */
+void deleteCase1(const Node* delete, Node* parent)
+{
+	if(parent->left == delete)
+	{
+		parent->left = NULL;
+	}
+	else
+	{
+		parent->right = NULL;
+	}
+}
+
+/**
+ * executes delete case number 2
+ * @param delete the node to delete
+ * @param child the child of the node
+ * @param parent the parent of the node
+ */
+void deleteCase2(const Node* delete, Node* child, Node* parent)
+{
+	if(parent->right == delete)
+	{
+		parent->right = child;
+		child->parent = parent;
+	}
+	else
+	{
+		parent->left = child;
+		child->parent = parent;
+	}
+	child->color = BLACK;
+}
+
+/**
+ * executes delete case 3B1
+ * @param parent the parent of the node to delete
+ * @param brother the brother of the node to delete
+ */
+void deleteCase3B1(Node* parent, Node* brother)
+{
+	parent->color = BLACK;
+	brother->color = RED;
+}
+
+/**
+ * executes delete case 3B2
+ * @param tree the tree
+ * @param parent the parent of the node to delete
+ * @param brother the brother of the node to delete
+ */
+void deleteCase3B2(const RBTree *tree, Node* parent, Node* brother)
+{
+	brother->color = RED;
+	deleteCase3(tree, parent, parent->parent, findBrother(parent));
+}
+
+/**
+ * executes delete case 3C
+ * @param tree the tree
+ * @param delete the node to delete
+ * @param parent the parent of the node to delete
+ * @param brother the brother of the node to delete
+ */
+void deleteCase3C(const RBTree *tree, Node* delete, Node* parent, Node* brother)
+{
+	brother->color = BLACK;
+	parent->color = RED;
+	if(parent->left == delete)
+	{
+		rotateLeft(tree, parent);
+	}
+	else
+	{
+		rotateRight(tree, parent);
+	}
+	deleteCase3(tree, delete, parent, findBrother(delete));
+}
+
+/**
+ * finds the far child of the brother
+ * @param delete the node to delete
+ * @param brother the brother
+ * @return the far child of the brother
+ */
+Node* findFarChild(const Node* delete, Node* brother)
+{
+	if(delete->parent->right == delete)
+	{
+		return brother->left;
+	}
+	return brother->right;
+}
+
+/**
+ * finds the close child of the brother
+ * @param delete the node to delete
+ * @param brother the brother
+ * @return the close child of the brother
+ */
+Node* findCloseChild(const Node* delete, Node* brother)
+{
+	if(delete->parent->right == delete)
+	{
+		return brother->right;
+	}
+	return brother->left;
+}
+
+/**
+ * executes delete case 3D
+ * @param tree the tree
+ * @param delete the node to delete
+ * @param parent the parent
+ * @param brother the brother
+ * @param closeChild the close child of the brother
+ */
+void deleteCase3D(const RBTree *tree, Node* delete, Node* parent, Node* brother, Node* closeChild)
+{
+	closeChild->color = BLACK;
+	brother->color = RED;
+	if(brother->left == closeChild)
+	{
+		rotateRight(tree, brother);
+	}
+	else
+	{
+		rotateLeft(tree, brother);
+	}
+	deleteCase3(tree, delete, parent, findBrother(delete));
+}
+
+/**
+ * executes delete case 3E
+ * @param tree the tree
+ * @param delete the node to delete
+ * @param parent the parent
+ * @param brother the brother
+ * @param farChild the far child of the brother
+ */
+void deleteCase3E(const RBTree *tree, Node* delete, Node* parent, Node* brother, Node* farChild)
+{
+	Color temp = brother->color;
+	brother->color = parent->color;
+	parent->color = temp;
+	if(parent->right == delete)
+	{
+		rotateRight(tree, parent);
+	}
+	else
+	{
+		rotateLeft(tree, parent);
+	}
+	farChild->color = BLACK;
+}
+
+/**
+ * responsible on the third delete case
+ * @param tree the tree
+ * @param delete the node to delete
+ * @param parent the parent of the node to delete
+ * @param brother the brother of the node to delete
+ */
+void deleteCase3(const RBTree *tree, Node* delete, Node* parent, Node* brother)
+{
+	if(delete->parent == NULL)
+	{
+		return;
+	}
+	else if(brother->color == BLACK && (brother->left == NULL || brother->left->color == BLACK) &&
+			(brother->right == NULL || brother->right->color == BLACK))
+	{
+		if(parent->color == RED)
+		{
+			deleteCase3B1(parent, brother);
+		}
+		else
+		{
+			deleteCase3B2(tree, parent, brother);
+		}
+	}
+	else if(brother->color == RED)
+	{
+		deleteCase3C(tree, delete, parent, brother);
+	}
+	else
+	{
+		Node* farChild = findFarChild(delete, brother);
+		Node* closeChild = findCloseChild(delete, brother);
+		if (brother->color == BLACK && (closeChild != NULL && closeChild->color == RED) &&
+			(farChild == NULL || farChild->color == BLACK))
+		{
+			deleteCase3D(tree, delete, parent, brother, closeChild);
+		}
+		else
+		{
+			deleteCase3E(tree, delete, parent, brother, farChild);
+		}
+	}
+}
+
+/**
+ * responsible of the delete cases
+ * @param tree the tree
+ * @param delete the node to delete
+ * @param parent the parent of the node to delete
+ * @param child the child of the node to delete
+ * @param brother the brother of the node to delete
+ */
+void deleteCases(const RBTree *tree, Node* delete, Node* parent, Node* child, Node* brother)
+{
+	if(delete->color == RED)
+	{
+		deleteCase1(delete, parent);
+	}
+	else if(child != NULL && delete->color == BLACK && child->color == RED)
+	{
+		deleteCase2(delete, child, parent);
+	}
+	else
+	{
+		deleteCase3(tree, delete, parent, brother);
+		if(parent->right == delete)
+		{
+			parent->right = NULL;
+		}
+		else
+		{
+			parent->left = NULL;
+		}
+	}
+
+}
 
 /**
- * responsible on the third delete case
- * @param delete the node to delete
- * @param parent the parent of the node to delete
- * @param brother the brother of the node to delete
+ * unlinks a node which has at most one child from a (sub)tree and balances it
+ * @param tree the tree
+ * @param root the root of the tree, updated if it changes
+ * @param deleteNode the node to unlink
  */
-void deleteCase3(Node* delete, Node* parent, Node* brother);
+void unlinkNode(const RBTree *tree, Node **root, Node *deleteNode)
+{
+	Node* child = findChild(deleteNode);
+	Node* brother = findBrother(deleteNode);
+	Node* parent = deleteNode->parent;
+	if(parent == NULL)
+	{
+		*root = child;
+		if(child != NULL)
+		{
+			child->color = BLACK;
+			child->parent = NULL;
+		}
+	}
+	else
+	{
+		deleteCases(tree, deleteNode, parent, child, brother);
+		augmentPath(tree, parent);
+		*root = findNewRoot(parent);
+	}
+}
 
 /**
- * constructs a new RBTree with the given CompareFunc.
- * comp: a function two compare two variables.
+ * removes a node from the tree, balances it and frees the node and its data. the node of the
+ * successor of the item is the one freed if the node has two children.
+ * @param tree the tree
+ * @param deleteNode the node of the item to remove
  */
-RBTree *newRBTree(CompareFunc compFunc, FreeFunc freeFunc)
+void removeTreeNode(RBTree *tree, Node *deleteNode)
 {
-	RBTree* newTree = (RBTree *) malloc(sizeof(RBTree));
-	if(newTree == NULL)
+	if(deleteNode->right != NULL && deleteNode->left != NULL)
 	{
-		return NULL;
+		deleteNode = changeWithSuccessor(tree, deleteNode);
 	}
-	newTree->compFunc = compFunc;
-	newTree->freeFunc = freeFunc;
-	newTree->size = 0;
-	newTree->root = NULL;
-	return newTree;
+	if(tree->compaction != NULL && tree->compaction->cursor == deleteNode)
+	{
+		tree->compaction->cursor = previousInOrder(deleteNode);
+	}
+	unlinkNode(tree, &tree->root, deleteNode);
+	discardNode(tree, deleteNode);
 }
 
 /**
- * check whether the tree RBTreeContains this item.
- * @param tree: the tree to add an item to.
- * @param data: item to check.
- * @return: 0 if the item is not in the tree, other if it is.
+ * remove an item from the tree
+ * @param tree: the tree to remove an item from.
+ * @param data: item to remove from the tree.
+ * @return: 0 on failure, other on success. (if data is not in the tree - failure. if the tree is
+ * counted, the counter of the item is decremented and the item is removed when it reaches 0).
  */
-int RBTreeContains(const RBTree *tree, const void *data)
+int deleteFromRBTree(RBTree *tree, void *data)
 {
 	if(tree == NULL || data == NULL)
 	{
 		return FAIL;
 	}
-	Node* runner = tree->root;
-	while(runner != NULL)
+	if(tree->bloom != NULL && bloomMayContain(tree->bloom, data) == 0)
 	{
-		int res = tree->compFunc(runner->data, data);
-		if(res == 0)
-		{
-			return SUCCESS;
-		}
-		if(res > 0)
-		{
-			runner = runner->left;
-		}
-		else
-		{
-			runner = runner->right;
-		}
+		return FAIL;
 	}
-	return FAIL;
+	Node* deleteNode = findNode(tree, data);
+	if(deleteNode == NULL)
+	{
+		return FAIL;
+	}
+	if(deleteNode->count > 1)
+	{
+		deleteNode->count--;
+		return SUCCESS;
+	}
+	removeTreeNode(tree, deleteNode);
+	deleteNode = NULL;
+	return SUCCESS;
 }
 
 /**
- * frees all the nodes and the data in the tree
- * @param treeNode the node to free
- * @param freeFunc the freeFunc from the user
+ * a rotation of the top down delete: the child of root on the other side of dir goes up, root goes
+ * down on the dir side and becomes red, the child becomes black
+ * @param tree the tree
+ * @param root the node to rotate
+ * @param dir 1 if root goes down to the right, 0 if to the left
+ * @return the node which took root's place
  */
-void freeNode(Node* treeNode, FreeFunc freeFunc)
+Node* singleRotation(RBTree *tree, Node* root, int dir)
 {
-	if(treeNode->right == NULL && treeNode->left == NULL)
+	Node* save = dir ? root->left : root->right;
+	if(dir)
 	{
-		freeFunc(treeNode->data);
-		free(treeNode);
+		rotateRight(tree, root);
 	}
-	else if(treeNode->right == NULL)
-	{
-		freeNode(treeNode->left, freeFunc);
-		freeFunc(treeNode->data);
-		free(treeNode);
-	}
-	else if(treeNode->left == NULL)
+	else
 	{
-		freeNode(treeNode->right, freeFunc);
-		freeFunc(treeNode->data);
-		free(treeNode);
+		rotateLeft(tree, root);
 	}
-	else
+	root->color = RED;
+	save->color = BLACK;
+	if(save->parent == NULL)
 	{
-		freeNode(treeNode->left, freeFunc);
-		freeNode(treeNode->right, freeFunc);
-		freeFunc(treeNode->data);
-		free(treeNode);
+		tree->root = save;
 	}
+	return save;
 }
 
+/**
+ * a double rotation of the top down delete
+ * @param tree the tree
+ * @param root the node to rotate
+ * @param dir 1 if root goes down to the right, 0 if to the left
+ * @return the node which took root's place
+ */
+Node* doubleRotation(RBTree *tree, Node* root, int dir)
+{
+	singleRotation(tree, dir ? root->left : root->right, !dir);
+	return singleRotation(tree, root, dir);
+}
 
 /**
- * free all memory of the data structure.
- * @param tree: pointer to the tree to free.
+ * makes the next node of the way down red (if it is not already) by borrowing from its sibling
+ * or by a color flip, so that a black node is never removed
+ * @param tree the tree
+ * @param current the current node of the way down
+ * @param parent its parent
+ * @param dir the direction the way continues from current (1 for right)
+ * @param last the direction from parent to current (1 for right)
+ * @return the parent of current after the fix
  */
-void freeRBTree(RBTree **tree)
+Node* pushRedDown(RBTree *tree, Node* current, Node* parent, int dir, int last)
 {
-	if(*tree != NULL)
+	Node* next = dir ? current->right : current->left;
+	Node* other = dir ? current->left : current->right;
+	if(isRed(current) || isRed(next))
 	{
-		if((*tree)->root != NULL)
-		{
-			freeNode((*tree)->root, (*tree)->freeFunc);
-		}
-		free(*tree);
+		return parent;
 	}
-	*tree = NULL;
+	if(isRed(other))
+	{
+		return singleRotation(tree, current, dir);
+	}
+	Node* sibling = parent == NULL ? NULL : (last ? parent->left : parent->right);
+	if(sibling == NULL)
+	{
+		return parent;
+	}
+	Node* farChild = last ? sibling->left : sibling->right;
+	Node* closeChild = last ? sibling->right : sibling->left;
+	if(!isRed(farChild) && !isRed(closeChild))
+	{
+		parent->color = BLACK;
+		sibling->color = RED;
+		current->color = RED;
+		return parent;
+	}
+	Node* top = isRed(closeChild) ? doubleRotation(tree, parent, last) : singleRotation(tree, parent, last);
+	current->color = RED;
+	top->color = RED;
+	top->left->color = BLACK;
+	top->right->color = BLACK;
+	return parent;
 }
 
 /**
- * find the location of a given data
- * @param tree the tree
- * @param data the data
- * @return NULL if the data is not in the tree, else pointer to the node with the data
+ * remove an item from the tree, balancing it in a single pass on the way down: a red node is
+ * pushed down the search path so the removed node is always red (or the root), and it is unlinked
+ * with no fix up and no pass back up.
+ * @param tree: the tree to remove an item from.
+ * @param data: item to remove from the tree.
+ * @return: 0 on failure, other on success. (same as deleteFromRBTree).
  */
-Node* findLocation(const RBTree *tree, const void *data)
+int deleteFromRBTreeTopDown(RBTree *tree, void *data)
 {
-	if(tree == NULL)
+	if(tree == NULL || data == NULL)
 	{
-		return NULL;
+		return FAIL;
 	}
-	Node* runner = tree->root;
-	Node* location = NULL;
-	while(runner != NULL)
+	if(tree->bloom != NULL && bloomMayContain(tree->bloom, data) == 0)
 	{
-		if(tree->compFunc(runner->data, data) == 0)
-		{
-			return runner;
-		}
-		if(tree->compFunc(runner->data, data) > 0)
+		return FAIL;
+	}
+	if(tree->hashIndex != NULL && hashIndexFind(tree, data) == NULL)
+	{
+		return FAIL;
+	}
+	Node* current = NULL;
+	Node* parent = NULL;
+	Node* found = NULL;
+	Node* next = tree->root;
+	int dir = 1;
+	while(next != NULL)
+	{
+		int last = dir;
+		parent = current;
+		current = next;
+		int compare = tree->compFunc(current->data, data);
+		if(compare == 0)
 		{
-			if(runner->left == NULL)
+			found = current;
+			if(found->count > 1)
 			{
-				location = runner;
+				found->count--;
 				break;
 			}
-			runner = runner->left;
 		}
-		else
+		dir = compare < 0;
+		parent = pushRedDown(tree, current, parent, dir, last);
+		next = dir ? current->right : current->left;
+	}
+	if(tree->root != NULL)
+	{
+		tree->root->color = BLACK;
+	}
+	if(found == NULL)
+	{
+		return FAIL;
+	}
+	if(next != NULL)
+	{
+		return SUCCESS;
+	}
+	// current is the predecessor of found (or found itself), it is red or the root and has at most one child.
+	swapPayload(tree, found, current);
+	if(tree->compaction != NULL && tree->compaction->cursor == current)
+	{
+		tree->compaction->cursor = previousInOrder(current);
+	}
+	Node* child = current->left != NULL ? current->left : current->right;
+	if(child != NULL)
+	{
+		child->parent = current->parent;
+	}
+	if(current->parent == NULL)
+	{
+		tree->root = child;
+		if(child != NULL)
 		{
-			if(runner->right == NULL)
-			{
-				location = runner;
-				break;
-			}
-			runner = runner->right;
+			child->color = BLACK;
 		}
 	}
-	return location;
+	else if(current->parent->left == current)
+	{
+		current->parent->left = child;
+	}
+	else
+	{
+		current->parent->right = child;
+	}
+	augmentPath(tree, current->parent);
+	discardNode(tree, current);
+	return SUCCESS;
 }
 
 /**
- * inits the values in the node
- * @param data the data
- * @return pointer to the new node
+ * links sorted nodes to a balanced subtree: the middle node is the root and the halves are its
+ * subtrees, so all the levels are full except the deepest one, whose nodes are red
+ * @param nodes the nodes in order
+ * @param count the number of nodes
+ * @param parent the parent of the subtree
+ * @param depth the depth of the root of the subtree
+ * @param redDepth the depth of the red nodes, 0 if there are none
+ * @return the root of the subtree, NULL if count is 0
  */
-Node* initNode(void* data)
+Node* buildBalanced(Node **nodes, long unsigned count, Node *parent, unsigned depth, unsigned redDepth)
 {
-	Node* newNode = (Node*) malloc(sizeof(Node));
-	if(newNode == NULL)
+	if(count == 0)
 	{
 		return NULL;
 	}
-	newNode->data = data;
-	newNode->color = RED;
-	newNode->left = NULL;
-	newNode->right = NULL;
-	newNode->parent = NULL;
-	return newNode;
+	long unsigned middle = count / 2;
+	Node* root = nodes[middle];
+	root->parent = parent;
+	root->color = depth > 0 && depth == redDepth ? RED : BLACK;
+	root->left = buildBalanced(nodes, middle, root, depth + 1, redDepth);
+	root->right = buildBalanced(nodes + middle + 1, count - middle - 1, root, depth + 1, redDepth);
+	return root;
 }
 
 /**
- * finds the uncle
- * @param parent node's parent
- * @param grandParent node's grandparent
- * @return pointer to the uncle node
+ * replaces the shape of the tree with a balanced tree of the given nodes, in O(count)
+ * @param tree the tree
+ * @param nodes the nodes of the tree in order
+ * @param count the number of nodes
  */
-Node* getUncle(const Node* parent, Node* grandParent)
+void rebuildTree(RBTree *tree, Node **nodes, long unsigned count)
 {
-	if(grandParent->right == parent)
+	unsigned redDepth = 0;
+	while((2UL << redDepth) <= count)
 	{
-		return grandParent->left;
+		redDepth++;
 	}
-	else
+	tree->root = buildBalanced(nodes, count, NULL, 0, redDepth);
+	if(tree->augmentFunc != NULL)
 	{
-		return grandParent->right;
+		augmentSubtree(tree, tree->root);
 	}
 }
 
 /**
- * insert case number 3
- * @param parent node's parent
- * @param grandParent node's grandparent
- * @param uncle node's uncle
+ * fill an empty tree with sorted items in O(n).
+ * @param tree: an empty tree, not a map.
+ * @param items: the items in a strictly ascending order.
+ * @param n: the number of items.
+ * @return: 0 on failure (the tree is left empty and the items are not taken), other on success.
  */
-void redFatherRedUncle(Node* parent, Node* grandParent, Node* uncle)
+int RBTreeBulkLoad(RBTree *tree, void *const *items, long unsigned n)
 {
-	parent->color = BLACK;
-	uncle->color = BLACK;
-	grandParent->color = RED;
+	if(tree == NULL || (items == NULL && n > 0) || tree->root != NULL || tree->valueFreeFunc != NULL)
+	{
+		return FAIL;
+	}
+	for(long unsigned i = 1; i < n; i++)
+	{
+		if(items[i - 1] == NULL || tree->compFunc(items[i - 1], items[i]) >= 0)
+		{
+			return FAIL;
+		}
+	}
+	if(n == 0)
+	{
+		return SUCCESS;
+	}
+	if(items[n - 1] == NULL)
+	{
+		return FAIL;
+	}
+	Node** nodes = (Node **) treeAlloc(tree, sizeof(Node *) * n);
+	NodeBlock* block = (NodeBlock *) treeAlloc(tree, sizeof(NodeBlock));
+	Node* blockNodes = (Node *) treeAlloc(tree, nodeSize(tree) * n);
+	if(nodes == NULL || block == NULL || blockNodes == NULL)
+	{
+		void* allocated[] = {nodes, block, blockNodes};
+		for(int i = 0; i < 3; i++)
+		{
+			if(allocated[i] != NULL)
+			{
+				treeFree(tree, allocated[i]);
+			}
+		}
+		return FAIL;
+	}
+	block->nodes = blockNodes;
+	block->capacity = n;
+	block->live = n;
+	block->next = tree->blocks;
+	tree->blocks = block;
+	for(long unsigned i = 0; i < n; i++)
+	{
+		nodes[i] = blockNode(tree, block, i);
+		fillNode(tree, nodes[i], items[i]);
+	}
+	rebuildTree(tree, nodes, n);
+	for(long unsigned i = 0; i < n; i++)
+	{
+		nodeAdded(tree, nodes[i]);
+	}
+	treeFree(tree, nodes);
+	return SUCCESS;
 }
 
 /**
- * rotates the tree to the right
- * @param newNode the node to rotate
+ * remove all the items a predicate selects, in O(n).
+ * @param tree: the tree to remove items from.
+ * @param predicate: returns other than 0 for an item to remove, 0 for an item to keep.
+ * @param args: more optional arguments to the predicate.
+ * @return: 0 on failure (the tree is not changed), other on success.
  */
-void rotateRight(Node* newNode)
+int RBTreeRemoveIf(RBTree *tree, forEachFunc predicate, void *args)
 {
-	Node* leftChild = newNode->left;
-	Node* parent = newNode->parent;
-	if(leftChild != NULL)
+	if(tree == NULL || predicate == NULL)
 	{
-		newNode->left = leftChild->right;
-		leftChild->right = newNode;
+		return FAIL;
 	}
-	else
+	if(tree->root == NULL)
 	{
-		newNode->left = NULL;
+		return SUCCESS;
 	}
-	newNode->parent = leftChild;
-	if (newNode->left != NULL)
+	Node** nodes = (Node **) treeAlloc(tree, sizeof(Node *) * tree->size);
+	if(nodes == NULL)
 	{
-		newNode->left->parent = newNode;
+		return FAIL;
 	}
-	if (parent != NULL)
+	long unsigned total = 0;
+	for(Node* runner = findSuccessor(tree->root); runner != NULL; runner = nextInOrder(runner))
+	{
+		nodes[total] = runner;
+		total++;
+	}
+	long unsigned kept = 0;
+	for(long unsigned i = 0; i < total; i++)
+	{
+		if(predicate(nodes[i]->data, args) == 0)
+		{
+			nodes[kept] = nodes[i];
+			kept++;
+			continue;
+		}
+		if(tree->compaction != NULL && tree->compaction->cursor == nodes[i])
+		{
+			tree->compaction->cursor = kept > 0 ? nodes[kept - 1] : NULL;
+		}
+		discardNode(tree, nodes[i]);
+	}
+	rebuildTree(tree, nodes, kept);
+	treeFree(tree, nodes);
+	return SUCCESS;
+}
+
+/**
+ * the black height of a subtree: the number of black nodes on every path from its root down
+ * @param node the root of the subtree
+ * @return the black height, 0 for an empty subtree
+ */
+unsigned blackHeight(const Node *node)
+{
+	unsigned height = 0;
+	for(; node != NULL; node = node->left)
+	{
+		if(node->color == BLACK)
+		{
+			height++;
+		}
+	}
+	return height;
+}
+
+/**
+ * counts the black nodes from a node up to the root of its tree
+ * @param node the node
+ * @param root where to write the root
+ * @return the number of black nodes on the way (including the node and the root)
+ */
+unsigned blackNodesUp(Node *node, Node **root)
+{
+	unsigned count = 0;
+	for(; node != NULL; node = node->parent)
+	{
+		if(node->color == BLACK)
+		{
+			count++;
+		}
+		*root = node;
+	}
+	return count;
+}
+
+/**
+ * makes a subtree a tree of its own, with a black root
+ * @param node the root of the subtree
+ * @param height the black height of the subtree, updated if the root is blackened
+ * @return the root
+ */
+Node* detachSubtree(Node *node, unsigned *height)
+{
+	if(node != NULL)
 	{
-		if (newNode == parent->left)
-		{
-			parent->left = leftChild;
-		}
-		else if (newNode == parent->right)
+		node->parent = NULL;
+		if(node->color == RED)
 		{
-			parent->right = leftChild;
+			node->color = BLACK;
+			(*height)++;
 		}
 	}
-	leftChild->parent = parent;
+	return node;
 }
 
 /**
- * rotates the tree to the left
- * @param newNode the node to rotate
+ * joins two trees and a node whose data is between them. the middle node is hanged red on the
+ * spine of the higher tree, at the black node of the height of the lower tree, and the red red
+ * conflict is fixed by insertRepairs, so the cost is the difference of the heights.
+ * @param tree the tree the nodes belong to
+ * @param left a tree of data lower than the middle node, with a black root
+ * @param leftHeight the black height of left
+ * @param middle the middle node
+ * @param right a tree of data higher than the middle node, with a black root
+ * @param rightHeight the black height of right
+ * @param height where to write the black height of the joined tree
+ * @return the root of the joined tree
  */
-void rotateLeft(Node* newNode)
+Node* joinTrees(RBTree *tree, Node *left, unsigned leftHeight, Node *middle, Node *right,
+				unsigned rightHeight, unsigned *height)
 {
-	Node* rightChild = newNode->right;
-	Node* parent = newNode->parent;
-	if(rightChild != NULL)
+	middle->parent = NULL;
+	middle->left = left;
+	middle->right = right;
+	if(leftHeight == rightHeight)
 	{
-		newNode->right = rightChild->left;
-		rightChild->left = newNode;
+		if(left != NULL)
+		{
+			left->parent = middle;
+		}
+		if(right != NULL)
+		{
+			right->parent = middle;
+		}
+		middle->color = BLACK;
+		augmentPath(tree, middle);
+		*height = leftHeight + 1;
+		return middle;
+	}
+	int higherLeft = leftHeight > rightHeight;
+	Node* lower = higherLeft ? right : left;
+	unsigned lowerHeight = higherLeft ? rightHeight : leftHeight;
+	Node* runner = higherLeft ? left : right;
+	unsigned runnerHeight = higherLeft ? leftHeight : rightHeight;
+	Node* parent = NULL;
+	while(runner != NULL && (runner->color == RED || runnerHeight > lowerHeight))
+	{
+		if(runner->color == BLACK)
+		{
+			runnerHeight--;
+		}
+		parent = runner;
+		runner = higherLeft ? runner->right : runner->left;
+	}
+	if(higherLeft)
+	{
+		middle->left = runner;
+		parent->right = middle;
 	}
 	else
 	{
-		newNode->right = NULL;
+		middle->right = runner;
+		parent->left = middle;
 	}
-	newNode->parent = rightChild;
-	if (newNode->right != NULL)
+	middle->parent = parent;
+	if(runner != NULL)
 	{
-		newNode->right->parent = newNode;
+		runner->parent = middle;
 	}
-	if (parent != NULL)
+	if(lower != NULL)
 	{
-		if (newNode == parent->left)
-		{
-			parent->left = rightChild;
-		}
-		else if (newNode == parent->right)
-		{
-			parent->right = rightChild;
-		}
+		lower->parent = middle;
 	}
-	rightChild->parent = parent;
-}
-
-/**
- * the second step of the 4 insert case
- * @param newNode the node to change
- */
-void secondStep(Node* newNode)
-{
-	Node* parent = newNode->parent;
-	Node* grandParent = parent->parent;
-	if(newNode == parent->left)
+	middle->color = RED;
+	augmentPath(tree, middle);
+	insertRepairs(tree, parent, middle);
+	// the subtrees of the lower tree and of runner were not changed, so the height of the joined
+	// tree is their height plus the black nodes above them.
+	Node* anchor = lower != NULL ? lower : runner;
+	Node* root = NULL;
+	if(anchor == NULL)
 	{
-		rotateRight(grandParent);
+		*height = blackNodesUp(middle, &root);
 	}
 	else
 	{
-		rotateLeft(grandParent);
+		*height = lowerHeight + blackNodesUp(anchor->parent, &root);
 	}
-	parent->color = BLACK;
-	grandParent->color = RED;
+	return root;
 }
 
 /**
- * insert case number 3
- * @param newNode the node to insert
- * @param parent the node's parent
- * @param grandParent the node's grandparent
+ * joins two trees where all the data of the first is lower than the data of the second, using the
+ * minimal node of the second as the middle node
+ * @param tree the tree the nodes belong to
+ * @param left the first tree, with a black root
+ * @param leftHeight the black height of left
+ * @param right the second tree, with a black root
+ * @param rightHeight the black height of right
+ * @return the root of the joined tree
  */
-void redFatherBlackUncle(Node* newNode, Node* parent, Node* grandParent)
+Node* joinAdjacent(RBTree *tree, Node *left, unsigned leftHeight, Node *right, unsigned rightHeight)
 {
-	if(newNode == parent->right && parent == grandParent->left)
+	if(right == NULL)
 	{
-		rotateLeft(parent);
-		newNode = newNode->left;
+		return left;
 	}
-	else if(newNode == parent->left && parent == grandParent->right)
+	if(left == NULL)
 	{
-		rotateRight(parent);
-		newNode = newNode->right;
+		return right;
 	}
-	secondStep(newNode);
+	Node* minimum = findSuccessor(right);
+	unlinkNode(tree, &right, minimum);
+	rightHeight = blackHeight(right);
+	right = detachSubtree(right, &rightHeight);
+	unsigned height = 0;
+	return joinTrees(tree, left, leftHeight, minimum, right, rightHeight, &height);
 }
 
 /**
- * the main function that responsible on the insert repairs
- * @param tree the tree
- * @param parent node's parent
- * @param newNode the node to insert
+ * splits a subtree to the nodes before a key and the nodes after it
+ * @param tree the tree the nodes belong to
+ * @param node the root of the subtree
+ * @param height the black height of the subtree
+ * @param key the key to split by
+ * @param equalLeft 1 if a node equal to the key goes to the left part, 0 if to the right part
+ * @param left where to write the left part (a tree with a black root)
+ * @param leftHeight where to write the black height of the left part
+ * @param right where to write the right part (a tree with a black root)
+ * @param rightHeight where to write the black height of the right part
  */
-void insertRepairs(RBTree* tree, Node* parent, Node* newNode)
+void splitTree(RBTree *tree, Node *node, unsigned height, const void *key, int equalLeft, Node **left,
+			   unsigned *leftHeight, Node **right, unsigned *rightHeight)
 {
-	if(parent == NULL)
+	if(node == NULL)
 	{
-		newNode->color = BLACK;
+		*left = NULL;
+		*right = NULL;
+		*leftHeight = 0;
+		*rightHeight = 0;
+		return;
 	}
-	else if(parent->color == BLACK)
+	unsigned childLeftHeight = height - (node->color == BLACK);
+	unsigned childRightHeight = childLeftHeight;
+	Node* childLeft = detachSubtree(node->left, &childLeftHeight);
+	Node* childRight = detachSubtree(node->right, &childRightHeight);
+	int compare = tree->compFunc(node->data, key);
+	if(compare == 0 && equalLeft == 0)
 	{
-		return;
+		*left = childLeft;
+		*leftHeight = childLeftHeight;
+		*right = joinTrees(tree, NULL, 0, node, childRight, childRightHeight, rightHeight);
+	}
+	else if(compare == 0)
+	{
+		*left = joinTrees(tree, childLeft, childLeftHeight, node, NULL, 0, leftHeight);
+		*right = childRight;
+		*rightHeight = childRightHeight;
+	}
+	else if(compare > 0)
+	{
+		Node* between = NULL;
+		unsigned betweenHeight = 0;
+		splitTree(tree, childLeft, childLeftHeight, key, equalLeft, left, leftHeight, &between, &betweenHeight);
+		*right = joinTrees(tree, between, betweenHeight, node, childRight, childRightHeight, rightHeight);
 	}
 	else
 	{
-		Node* grandParent = parent->parent;
-		Node* uncle = getUncle(parent, grandParent);
-		if(uncle == NULL || uncle->color == BLACK)
+		Node* between = NULL;
+		unsigned betweenHeight = 0;
+		splitTree(tree, childRight, childRightHeight, key, equalLeft, &between, &betweenHeight, right, rightHeight);
+		*left = joinTrees(tree, childLeft, childLeftHeight, node, between, betweenHeight, leftHeight);
+	}
+}
+
+/**
+ * discards all the nodes of a detached subtree without recursion, like freeNodes
+ * @param tree the tree the nodes belonged to
+ * @param top the root of the subtree
+ */
+void discardNodes(RBTree *tree, Node *top)
+{
+	while(top != NULL)
+	{
+		if(top->left != NULL)
 		{
-			redFatherBlackUncle(newNode, parent, grandParent);
+			Node* left = top->left;
+			top->left = left->right;
+			left->right = top;
+			top = left;
 		}
 		else
 		{
-			redFatherRedUncle(parent, grandParent, uncle);
-			insertRepairs(tree, grandParent->parent, grandParent);
+			Node* right = top->right;
+			discardNode(tree, top);
+			top = right;
 		}
 	}
 }
 
 /**
- * hangs the node on the tree
- * @param parent the parent of the node
- * @param newNode the node to hang
- * @param tree the tree
+ * remove all the items between two bounds in O(log n + k) for k removed items.
+ * @param tree: the tree to remove items from.
+ * @param lo: the lowest item to remove (it does not have to be in the tree).
+ * @param hi: the highest item to remove (it does not have to be in the tree).
+ * @return: 0 on failure, other on success.
  */
-void hangNode(Node* parent, Node* newNode, RBTree *tree)
+int RBTreeDeleteRange(RBTree *tree, const void *lo, const void *hi)
 {
-	if(parent == NULL)
+	if(tree == NULL || lo == NULL || hi == NULL || tree->compFunc(lo, hi) > 0)
 	{
-		tree->root = newNode;
+		return FAIL;
 	}
-	else
+	if(tree->root == NULL)
 	{
-		newNode->parent = parent;
-		if (tree->compFunc(parent->data, newNode->data) > 0)
+		return SUCCESS;
+	}
+	Node* cursor = tree->compaction != NULL ? tree->compaction->cursor : NULL;
+	if(cursor != NULL && tree->compFunc(cursor->data, lo) >= 0 && tree->compFunc(cursor->data, hi) <= 0)
+	{
+		// the compaction continues after the last node before the range.
+		Node* before = NULL;
+		for(Node* runner = tree->root; runner != NULL;)
 		{
-			parent->left = newNode;
+			if(tree->compFunc(runner->data, lo) < 0)
+			{
+				before = runner;
+				runner = runner->right;
+			}
+			else
+			{
+				runner = runner->left;
+			}
+		}
+		tree->compaction->cursor = before;
+	}
+	Node* below = NULL;
+	Node* rest = NULL;
+	Node* range = NULL;
+	Node* above = NULL;
+	unsigned belowHeight = 0;
+	unsigned restHeight = 0;
+	unsigned rangeHeight = 0;
+	unsigned aboveHeight = 0;
+	splitTree(tree, tree->root, blackHeight(tree->root), lo, 0, &below, &belowHeight, &rest, &restHeight);
+	splitTree(tree, rest, restHeight, hi, 1, &range, &rangeHeight, &above, &aboveHeight);
+	tree->root = joinAdjacent(tree, below, belowHeight, above, aboveHeight);
+	discardNodes(tree, range);
+	return SUCCESS;
+}
+
+/**
+ * sorts the operations of a batch by their items, keeping the order of operations on the same item
+ * (a merge sort)
+ * @param ops the operations
+ * @param compFunc the function to compare the items
+ * @param order the indices of the operations to sort
+ * @param scratch room for n indices
+ * @param n the number of indices
+ */
+void sortBatchOps(const BatchOp *ops, CompareFunc compFunc, long unsigned *order, long unsigned *scratch,
+				  long unsigned n)
+{
+	if(n < 2)
+	{
+		return;
+	}
+	long unsigned half = n / 2;
+	sortBatchOps(ops, compFunc, order, scratch, half);
+	sortBatchOps(ops, compFunc, order + half, scratch, n - half);
+	long unsigned left = 0, right = half, merged = 0;
+	while(left < half || right < n)
+	{
+		if(right == n || (left < half && compFunc(ops[order[right]].data, ops[order[left]].data) >= 0))
+		{
+			scratch[merged] = order[left];
+			left++;
 		}
 		else
 		{
-			parent->right = newNode;
+			scratch[merged] = order[right];
+			right++;
 		}
+		merged++;
 	}
+	memcpy(order, scratch, sizeof(long unsigned) * n);
 }
 
 /**
- * finds the new root after the insert
- * @param newNode
- * @return pointer to the root
+ * runs the operations of a batch on one item against the tree without changing it, sets their
+ * outcomes and adds the change to the item if there is one
+ * @param batch the batch
+ * @param order the indices of the operations on the item, in their order
+ * @param count the number of operations
  */
-Node* findNewRoot(Node* newNode)
+void resolveBatchItem(PreparedBatch *batch, const long unsigned *order, long unsigned count)
 {
-	while (newNode->parent != NULL)
+	const BatchOp* ops = batch->ops;
+	Node* old = findNode(batch->tree, ops[order[0]].data);
+	int present = old != NULL;
+	long unsigned inserted = 0; // 1 + the index of the insert whose item is in the tree, 0 if none.
+	for(long unsigned i = 0; i < count; i++)
+	{
+		long unsigned index = order[i];
+		batch->status[index] = BATCH_OP_FAILED;
+		if(ops[index].type == BATCH_INSERT && present == 0)
+		{
+			batch->status[index] = BATCH_OP_APPLIED;
+			present = 1;
+			inserted = index + 1;
+		}
+		else if(ops[index].type == BATCH_DELETE && present)
+		{
+			batch->status[index] = BATCH_OP_APPLIED;
+			present = 0;
+			if(inserted > 0)
+			{
+				batch->status[inserted - 1] = BATCH_OP_UNDONE;
+				inserted = 0;
+			}
+		}
+	}
+	if(inserted == 0 && (old == NULL || present))
 	{
-		newNode = newNode->parent;
+		return;
 	}
-	return newNode;
+	BatchChange* change = &batch->changes[batch->numChanges];
+	change->old = old;
+	change->data = inserted > 0 ? ops[inserted - 1].data : NULL;
+	change->node = NULL;
+	batch->numChanges++;
 }
 
 /**
- * add an item to the tree
- * @param tree: the tree to add an item to.
- * @param data: item to add to the tree.
- * @return: 0 on failure, other on success. (if the item is already in the tree - failure).
+ * checks whether applying changes to a tree is cheaper by merging them with all its nodes and
+ * rebuilding it, than by hanging and removing the nodes one by one (O(log n) each)
+ * @param tree the tree
+ * @param numChanges the number of changes
+ * @return 1 if the tree should be rebuilt, else 0
  */
-int insertToRBTree(RBTree *tree, void *data)
+int batchRebuilds(const RBTree *tree, long unsigned numChanges)
 {
-	if(tree == NULL || data == NULL || RBTreeContains(tree, data) != 0)
+	long unsigned depth = 1;
+	while((1UL << depth) <= tree->size)
 	{
-		return FAIL;
+		depth++;
 	}
-	Node* parent = findLocation(tree, data);
-	Node* newNode = initNode(data);
-	if(newNode == NULL)
+	return numChanges * depth >= tree->size;
+}
+
+/**
+ * frees the memory of a batch, except for its new nodes
+ * @param batch the batch
+ */
+void freePreparedBatch(PreparedBatch *batch)
+{
+	const RBTree* tree = batch->tree;
+	void* allocated[] = {batch->status, batch->changes, batch->merged};
+	for(int i = 0; i < 3; i++)
 	{
-		return FAIL;
+		if(allocated[i] != NULL)
+		{
+			treeFree(tree, allocated[i]);
+		}
 	}
-	hangNode(parent, newNode, tree);
-	insertRepairs(tree, parent, newNode);
-	tree->size++;
-	tree->root = findNewRoot(newNode);
-	return SUCCESS;
+	treeFree(tree, batch);
 }
 
 /**
- *
- * @param curNode the current node
- * @param func the func to apply on the nodes
- * @param args extra args
- * @return 0 if the func failed, else the value of the run
+ * the first step of RBTreeApplyBatch: sort and resolve the batch and allocate its memory, without
+ * changing the tree. the tree must not be changed until the batch is committed or aborted, so a
+ * caller can prepare batches of several trees and commit all of them only if all were prepared.
+ * @param tree: the tree, not a map and not counted.
+ * @param ops: the operations, they must stay valid until the batch is committed or aborted.
+ * @param n: the number of operations.
+ * @return: the prepared batch, NULL on failure.
  */
-int forEachRBTreeHelper(Node* curNode, forEachFunc func, void *args)
+PreparedBatch *RBTreePrepareBatch(RBTree *tree, const BatchOp *ops, long unsigned n)
 {
-	if(curNode == NULL)
+	if(tree == NULL || tree->valueFreeFunc != NULL || tree->counted || (n > 0 && ops == NULL))
 	{
-		return FAIL;
+		return NULL;
 	}
-	if(curNode->left != NULL)
+	for(long unsigned i = 0; i < n; i++)
 	{
-		int res = forEachRBTreeHelper(curNode->left, func, args);
-		if(res == 0)
+		if(ops[i].data == NULL || (ops[i].type != BATCH_INSERT && ops[i].type != BATCH_DELETE))
 		{
-			return FAIL;
+			return NULL;
 		}
 	}
-	int val = func(curNode->data, args);
-	if(curNode->right != NULL)
+	PreparedBatch* batch = (PreparedBatch *) treeAlloc(tree, sizeof(PreparedBatch));
+	if(batch == NULL)
 	{
-		int res = forEachRBTreeHelper(curNode->right, func, args);
-		if(res == 0)
+		return NULL;
+	}
+	batch->tree = tree;
+	batch->ops = ops;
+	batch->n = n;
+	batch->numChanges = 0;
+	batch->merged = NULL;
+	batch->status = (unsigned char *) treeAlloc(tree, n + 1);
+	batch->changes = (BatchChange *) treeAlloc(tree, sizeof(BatchChange) * (n + 1));
+	long unsigned* order = (long unsigned *) treeAlloc(tree, sizeof(long unsigned) * (n + 1));
+	long unsigned* scratch = (long unsigned *) treeAlloc(tree, sizeof(long unsigned) * (n + 1));
+	if(batch->status == NULL || batch->changes == NULL || order == NULL || scratch == NULL)
+	{
+		if(order != NULL)
 		{
-			return FAIL;
+			treeFree(tree, order);
+		}
+		if(scratch != NULL)
+		{
+			treeFree(tree, scratch);
 		}
+		freePreparedBatch(batch);
+		return NULL;
 	}
-	return val;
-}
-
-/**
- * Activate a function on each item of the tree. the order is an ascending order. if one of the activations of the
- * function returns 0, the process stops.
- * @param tree: the tree with all the items.
- * @param func: the function to activate on all items.
- * @param args: more optional arguments to the function (may be null if the given function support it).
- * @return: 0 on failure, other on success.
- */
-int forEachRBTree(const RBTree *tree, forEachFunc func, void *args)
-{
-	if(tree == NULL)
+	for(long unsigned i = 0; i < n; i++)
 	{
-		return FAIL;
+		order[i] = i;
 	}
-	if(tree->root == NULL)
+	sortBatchOps(ops, tree->compFunc, order, scratch, n);
+	treeFree(tree, scratch);
+	long unsigned end = 0;
+	for(long unsigned start = 0; start < n; start = end)
 	{
-		return SUCCESS;
+		end = start + 1;
+		while(end < n && tree->compFunc(ops[order[end]].data, ops[order[start]].data) == 0)
+		{
+			end++;
+		}
+		resolveBatchItem(batch, order + start, end - start);
 	}
-	int res = forEachRBTreeHelper(tree->root, func, args);
-	if(res == 0)
+	treeFree(tree, order);
+	for(long unsigned i = 0; i < batch->numChanges; i++)
 	{
-		return FAIL;
+		if(batch->changes[i].data != NULL)
+		{
+			batch->changes[i].node = (Node *) treeAlloc(tree, nodeSize(tree));
+			if(batch->changes[i].node == NULL)
+			{
+				RBTreeAbortBatch(&batch);
+				return NULL;
+			}
+		}
 	}
-	return SUCCESS;
+	if(batch->numChanges > 0 && batchRebuilds(tree, batch->numChanges))
+	{
+		batch->merged = (Node **) treeAlloc(tree, sizeof(Node *) * (tree->size + batch->numChanges));
+		if(batch->merged == NULL)
+		{
+			RBTreeAbortBatch(&batch);
+			return NULL;
+		}
+	}
+	return batch;
 }
 
 /**
- * finds the successor of the node
- * @param n the node
- * @return the successor
+ * applies the changes of a batch by merging them with the nodes of the tree in order and
+ * rebuilding the tree. the nodes of the tree are collected to the end of the merged array first,
+ * where the merge (which writes from its beginning) reads them before it overwrites them.
+ * @param batch the batch
  */
-Node* findSuccessor(Node* n)
+void mergeBatch(PreparedBatch *batch)
 {
-	if(n->left == NULL)
-	{
-		return n;
+	RBTree* tree = batch->tree;
+	Node** merged = batch->merged;
+	Node** nodes = merged + batch->numChanges;
+	long unsigned total = 0;
+	for(Node* runner = tree->root == NULL ? NULL : findSuccessor(tree->root); runner != NULL;
+		runner = nextInOrder(runner))
+	{
+		nodes[total] = runner;
+		total++;
+	}
+	long unsigned count = 0, next = 0;
+	for(long unsigned i = 0; i <= total; i++)
+	{
+		Node* current = i < total ? nodes[i] : NULL;
+		while(next < batch->numChanges && batch->changes[next].old == NULL &&
+			(current == NULL || tree->compFunc(batch->changes[next].data, current->data) < 0))
+		{
+			fillNode(tree, batch->changes[next].node, batch->changes[next].data);
+			merged[count] = batch->changes[next].node;
+			count++;
+			next++;
+		}
+		if(current == NULL)
+		{
+			break;
+		}
+		if(next == batch->numChanges || batch->changes[next].old != current)
+		{
+			merged[count] = current;
+			count++;
+			continue;
+		}
+		if(batch->changes[next].node != NULL)
+		{
+			fillNode(tree, batch->changes[next].node, batch->changes[next].data);
+			merged[count] = batch->changes[next].node;
+			count++;
+		}
+		if(tree->compaction != NULL && tree->compaction->cursor == current)
+		{
+			tree->compaction->cursor = count > 0 ? merged[count - 1] : NULL;
+		}
+		discardNode(tree, current);
+		next++;
 	}
-	else
+	rebuildTree(tree, merged, count);
+	for(long unsigned i = 0; i < batch->numChanges; i++)
 	{
-		return findSuccessor(n->left);
+		if(batch->changes[i].node != NULL)
+		{
+			nodeAdded(tree, batch->changes[i].node);
+		}
 	}
 }
 
 /**
- * changes the data of the node to delete with his successor
- * @param deleteNode the node to delete
- * @return the successor node
- */
-Node* changeWithSuccessor(Node* deleteNode)
-{
-	Node* successor = findSuccessor(deleteNode->right);
-	void* temp = deleteNode->data;
-	deleteNode->data = successor->data;
-	successor->data = temp;
-	return successor;
-}
-
-/**
- * finds the child of the node
- * @param n the node
- * @return the child
+ * apply a prepared batch to its tree and free it. it cannot fail.
+ * @param batch: pointer to the prepared batch.
+ * @param results: the same as the results of RBTreeApplyBatch.
  */
-Node* findChild(Node* n)
+void RBTreeCommitBatch(PreparedBatch **batch, int *results)
 {
-	if(n->left != NULL)
+	if(*batch == NULL)
 	{
-		return n->left;
+		return;
 	}
-	else if(n->right != NULL)
+	PreparedBatch* prepared = *batch;
+	RBTree* tree = prepared->tree;
+	for(long unsigned i = 0; i < prepared->n; i++)
 	{
-		return n->right;
+		if(results != NULL)
+		{
+			results[i] = prepared->status[i] != BATCH_OP_FAILED;
+		}
+		if(prepared->status[i] == BATCH_OP_UNDONE)
+		{
+			freeData(tree, prepared->ops[i].data);
+		}
+	}
+	if(prepared->merged != NULL)
+	{
+		mergeBatch(prepared);
+	}
+	else
+	{
+		// from the highest item down: removing a node with two children frees the node of its
+		// successor, which belongs to a change that was already applied.
+		for(long unsigned i = prepared->numChanges; i > 0; i--)
+		{
+			BatchChange* change = &prepared->changes[i - 1];
+			if(change->old != NULL)
+			{
+				removeTreeNode(tree, change->old);
+			}
+			if(change->node != NULL)
+			{
+				fillNode(tree, change->node, change->data);
+				int compare = 0;
+				Node* parent = findLocation(tree, change->node->data, &compare);
+				linkNewNode(tree, parent, change->node, compare);
+			}
+		}
 	}
-	return NULL;
+	freePreparedBatch(prepared);
+	*batch = NULL;
 }
 
 /**
- * finds the brother of the node
- * @param n the node
- * @return the brother
+ * free a prepared batch without applying it.
+ * @param batch: pointer to the prepared batch.
  */
-Node* findBrother(Node* n)
+void RBTreeAbortBatch(PreparedBatch **batch)
 {
-	if(n->parent == NULL)
+	if(*batch == NULL)
 	{
-		return NULL;
+		return;
 	}
-	if(n->parent->left == n)
+	for(long unsigned i = 0; i < (*batch)->numChanges; i++)
 	{
-		return n->parent->right;
+		if((*batch)->changes[i].node != NULL)
+		{
+			treeFree((*batch)->tree, (*batch)->changes[i].node);
+		}
 	}
-	return n->parent->left;
+	freePreparedBatch(*batch);
+	*batch = NULL;
 }
 
 /**
- * executes delete case number 1
- * @param delete the node to delete
- * @param parent the parent of the node to delete
+ * apply a batch of inserts and deletes, with the same results as applying them one by one in the
+ * given order. the batch is sorted (operations on the same item keep their order) and resolved to
+ * one change per item before the tree is touched, then small batches are hanged node by node and
+ * large ones are merged with the tree in one pass and rebuilt in O(n).
+ * all the memory is allocated first, so either the whole batch is applied or nothing is.
+ * @param tree: the tree, not a map and not counted.
+ * @param ops: the operations.
+ * @param n: the number of operations.
+ * @param results: may be NULL. else an array of n ints, results[i] is set to 0 if ops[i] failed
+ * (an insert of an item which was in the tree, and then it still belongs to the caller, or a delete
+ * of an item which was not), other if it succeeded.
+ * @return: 0 on failure (the tree is not changed and no item is taken), other on success.
  */
-void deleteCase1(const Node* delete, Node* parent)
+int RBTreeApplyBatch(RBTree *tree, const BatchOp *ops, long unsigned n, int *results)
 {
-	if(parent->left == delete)
-	{
-		parent->left = NULL;
-	}
-	else
+	PreparedBatch* batch = RBTreePrepareBatch(tree, ops, n);
+	if(batch == NULL)
 	{
-		parent->right = NULL;
+		return FAIL;
 	}
+	RBTreeCommitBatch(&batch, results);
+	return SUCCESS;
 }
 
 /**
- * executes delete case number 2
- * @param delete the node to delete
- * @param child the child of the node
- * @param parent the parent of the node
+ * moves a node to a new address and fixes the pointers to it
+ * @param tree the tree
+ * @param from the node
+ * @param to the new address of the node
  */
-void deleteCase2(const Node* delete, Node* child, Node* parent)
+void relocateNode(RBTree *tree, Node *from, Node *to)
 {
-	if(parent->right == delete)
+	if(tree->hashIndex != NULL)
 	{
-		parent->right = child;
-		child->parent = parent;
+		hashIndexEntry(tree->hashIndex, from)->node = to;
+	}
+	memcpy(to, from, nodeSize(tree));
+	if(isInline(tree, from))
+	{
+		if(tree->hotCache != NULL)
+		{
+			hotCacheInvalidate(tree->hotCache, from->data);
+		}
+		to->data = to + 1;
+	}
+	if(to->parent == NULL)
+	{
+		tree->root = to;
+	}
+	else if(to->parent->left == from)
+	{
+		to->parent->left = to;
 	}
 	else
 	{
-		parent->left = child;
-		child->parent = parent;
+		to->parent->right = to;
+	}
+	if(to->left != NULL)
+	{
+		to->left->parent = to;
+	}
+	if(to->right != NULL)
+	{
+		to->right->parent = to;
 	}
-	child->color = BLACK;
 }
 
 /**
- * executes delete case 3B1
- * @param parent the parent of the node to delete
- * @param brother the brother of the node to delete
+ * starts a compaction into a new block large enough for all the nodes of the tree
+ * @param tree the tree
+ * @return 0 on failure, 1 on success
  */
-void deleteCase3B1(Node* parent, Node* brother)
+int startCompaction(RBTree *tree)
 {
-	parent->color = BLACK;
-	brother->color = RED;
+	Compaction* compaction = (Compaction *) treeAlloc(tree, sizeof(Compaction));
+	NodeBlock* block = (NodeBlock *) treeAlloc(tree, sizeof(NodeBlock));
+	Node* nodes = (Node *) treeAlloc(tree, nodeSize(tree) * tree->size);
+	if(compaction == NULL || block == NULL || nodes == NULL)
+	{
+		void* allocated[] = {compaction, block, nodes};
+		for(int i = 0; i < 3; i++)
+		{
+			if(allocated[i] != NULL)
+			{
+				treeFree(tree, allocated[i]);
+			}
+		}
+		return FAIL;
+	}
+	block->nodes = nodes;
+	block->capacity = tree->size;
+	block->live = 0;
+	block->next = tree->blocks;
+	tree->blocks = block;
+	compaction->block = block;
+	compaction->filled = 0;
+	compaction->cursor = NULL;
+	tree->compaction = compaction;
+	return SUCCESS;
 }
 
 /**
- * executes delete case 3B2
- * @param parent the parent of the node to delete
- * @param brother the brother of the node to delete
+ * ends the compaction, freeing its block if all its nodes were deleted meanwhile
+ * @param tree the tree
  */
-void deleteCase3B2(Node* parent, Node* brother)
+void endCompaction(RBTree *tree)
 {
-	brother->color = RED;
-	deleteCase3(parent, parent->parent, findBrother(parent));
+	NodeBlock* block = tree->compaction->block;
+	treeFree(tree, tree->compaction);
+	tree->compaction = NULL;
+	if(block->live == 0)
+	{
+		freeBlock(tree, block);
+	}
 }
 
 /**
- * executes delete case 3C
- * @param delete the node to delete
- * @param parent the parent of the node to delete
- * @param brother the brother of the node to delete
+ * relocate the nodes of the tree, in order, to one contiguous block, so walking the tree in order
+ * reads the memory sequentially. the work may be split to bounded steps: inserts and deletes may be
+ * done between the calls, and the compaction continues from where it stopped.
+ * @param tree: the tree to compact.
+ * @param budget: the maximal number of nodes to relocate in this call, 0 for no limit.
+ * @param finished: set to 1 if the compaction is complete, 0 if more calls are needed.
+ * @return: 0 on failure, other on success.
  */
-void deleteCase3C(Node* delete, Node* parent, Node* brother)
+int RBTreeCompact(RBTree *tree, long unsigned budget, int *finished)
 {
-	brother->color = BLACK;
-	parent->color = RED;
-	if(parent->left == delete)
+	if(tree == NULL || finished == NULL)
 	{
-		rotateLeft(parent);
+		return FAIL;
 	}
-	else
+	*finished = 0;
+	if(tree->compaction == NULL)
+	{
+		if(tree->root == NULL)
+		{
+			*finished = 1;
+			return SUCCESS;
+		}
+		if(startCompaction(tree) == FAIL)
+		{
+			return FAIL;
+		}
+	}
+	Compaction* compaction = tree->compaction;
+	NodeBlock* block = compaction->block;
+	for(long unsigned steps = 0; budget == 0 || steps < budget; steps++)
 	{
-		rotateRight(parent);
+		Node* next = NULL;
+		if(compaction->cursor != NULL)
+		{
+			next = nextInOrder(compaction->cursor);
+		}
+		else if(tree->root != NULL)
+		{
+			next = tree->root;
+			while(next->left != NULL)
+			{
+				next = next->left;
+			}
+		}
+		if(next == NULL || compaction->filled == block->capacity)
+		{
+			endCompaction(tree);
+			*finished = 1;
+			return SUCCESS;
+		}
+		if(inBlock(tree, block, next) == 0)
+		{
+			Node* slot = blockNode(tree, block, compaction->filled);
+			relocateNode(tree, next, slot);
+			compaction->filled++;
+			block->live++;
+			releaseNode(tree, next);
+			next = slot;
+		}
+		compaction->cursor = next;
 	}
-	deleteCase3(delete, parent, findBrother(delete));
+	return SUCCESS;
 }
 
 /**
- * finds the far child of the brother
- * @param delete the node to delete
- * @param brother the brother
- * @return the far child of the brother
+ * copies a subtree in pre order to the next nodes of the block of a job
+ * @param job the job
+ * @param source the root of the subtree
+ * @param parent the copy of the parent of the subtree
+ * @param depth the depth of the subtree
+ * @param jobDepth the depth where subtrees are left for other jobs, 0 for no limit
+ * @param jobs where to add the jobs of the subtrees at jobDepth
+ * @param numJobs the number of jobs added so far
+ * @return the copy of the subtree
  */
-Node* findFarChild(const Node* delete, Node* brother)
+Node* copySubtree(CloneJob *job, const Node *source, Node *parent, unsigned depth, unsigned jobDepth,
+				  CloneJob *jobs, unsigned *numJobs)
 {
-	if(delete->parent->right == delete)
+	if(source == NULL || job->failed)
 	{
-		return brother->left;
+		return NULL;
 	}
-	return brother->right;
+	Node* node = blockNode(job->clone, job->block, job->next);
+	job->next++;
+	memcpy(node, source, nodeSize(job->clone));
+	node->parent = parent;
+	if(isInline(job->tree, source))
+	{
+		node->data = node + 1;
+	}
+	else if(job->copyFunc != NULL)
+	{
+		node->data = job->copyFunc(source->data);
+		if(node->data == NULL)
+		{
+			job->failed = 1;
+			return NULL;
+		}
+	}
+	const Node* children[] = {source->left, source->right};
+	Node** links[] = {&node->left, &node->right};
+	for(int i = 0; i < 2; i++)
+	{
+		if(jobDepth > 0 && depth + 1 == jobDepth && children[i] != NULL)
+		{
+			jobs[*numJobs] = *job;
+			jobs[*numJobs].source = children[i];
+			jobs[*numJobs].parent = node;
+			jobs[*numJobs].link = links[i];
+			jobs[*numJobs].first = 0;
+			jobs[*numJobs].next = 0;
+			(*numJobs)++;
+			*links[i] = NULL;
+		}
+		else
+		{
+			*links[i] = copySubtree(job, children[i], node, depth + 1, jobDepth, jobs, numJobs);
+		}
+	}
+	return node;
 }
 
 /**
- * finds the close child of the brother
- * @param delete the node to delete
- * @param brother the brother
- * @return the close child of the brother
+ * counts the nodes of a subtree
+ * @param node the root of the subtree
+ * @return the number of nodes
  */
-Node* findCloseChild(const Node* delete, Node* brother)
+long unsigned countNodes(const Node *node)
 {
-	if(delete->parent->right == delete)
+	if(node == NULL)
 	{
-		return brother->right;
+		return 0;
 	}
-	return brother->left;
+	return 1 + countNodes(node->left) + countNodes(node->right);
 }
 
 /**
- * executes delete case 3D
- * @param delete the node to delete
- * @param parent the parent
- * @param brother the brother
- * @param closeChild the close child of the brother
+ * thread function that counts the nodes of the subtree of a job
+ * @param args the job
+ * @return NULL
  */
-void deleteCase3D(Node* delete, Node* parent, Node* brother, Node* closeChild)
+void *countCloneJob(void *args)
 {
-	closeChild->color = BLACK;
-	brother->color = RED;
-	if(brother->left == closeChild)
-	{
-		rotateRight(brother);
-	}
-	else
-	{
-		rotateLeft(brother);
-	}
-	deleteCase3(delete, parent, findBrother(delete));
+	CloneJob* job = (CloneJob *) args;
+	job->size = countNodes(job->source);
+	return NULL;
 }
 
 /**
- * executes delete case 3E
- * @param delete the node to delete
- * @param parent the parent
- * @param brother the brother
- * @param farChild the far child of the brother
+ * thread function that copies the subtree of a job
+ * @param args the job
+ * @return NULL
  */
-void deleteCase3E(Node* delete, Node* parent, Node* brother, Node* farChild)
+void *runCloneJob(void *args)
 {
-	Color temp = brother->color;
-	brother->color = parent->color;
-	parent->color = temp;
-	if(parent->right == delete)
-	{
-		rotateRight(parent);
-	}
-	else
-	{
-		rotateLeft(parent);
-	}
-	farChild->color = BLACK;
+	CloneJob* job = (CloneJob *) args;
+	*job->link = copySubtree(job, job->source, job->parent, 0, 0, NULL, NULL);
+	return NULL;
 }
 
 /**
- * responsible on the third delete case
- * @param delete the node to delete
- * @param parent the parent of the node to delete
- * @param brother the brother of the node to delete
+ * runs a thread function on all the jobs, each job on a thread of its own (or on the calling
+ * thread if a thread cannot be created)
+ * @param jobs the jobs
+ * @param numJobs the number of jobs
+ * @param func the thread function
  */
-void deleteCase3(Node* delete, Node* parent, Node* brother)
+void runCloneJobs(CloneJob *jobs, unsigned numJobs, void *(*func)(void *))
 {
-	if(delete->parent == NULL)
-	{
-		return;
-	}
-	else if(brother->color == BLACK && (brother->left == NULL || brother->left->color == BLACK) &&
-			(brother->right == NULL || brother->right->color == BLACK))
+	pthread_t threads[MAX_CLONE_JOBS];
+	int started[MAX_CLONE_JOBS];
+	for(unsigned i = 0; i < numJobs; i++)
 	{
-		if(parent->color == RED)
-		{
-			deleteCase3B1(parent, brother);
-		}
-		else
+		started[i] = pthread_create(&threads[i], NULL, func, &jobs[i]) == 0;
+		if(started[i] == 0)
 		{
-			deleteCase3B2(parent, brother);
+			func(&jobs[i]);
 		}
 	}
-	else if(brother->color == RED)
-	{
-		deleteCase3C(delete, parent, brother);
-	}
-	else
+	for(unsigned i = 0; i < numJobs; i++)
 	{
-		Node* farChild = findFarChild(delete, brother);
-		Node* closeChild = findCloseChild(delete, brother);
-		if (brother->color == BLACK && (closeChild != NULL && closeChild->color == RED) &&
-			(farChild == NULL || farChild->color == BLACK))
-		{
-			deleteCase3D(delete, parent, brother, closeChild);
-		}
-		else
+		if(started[i])
 		{
-			deleteCase3E(delete, parent, brother, farChild);
+			pthread_join(threads[i], NULL);
 		}
 	}
 }
 
 /**
- * responsible of the delete cases
- * @param delete the node to delete
- * @param parent the parent of the node to delete
- * @param child the child of the node to delete
- * @param brother the brother of the node to delete
+ * frees the items a failed clone copied
+ * @param clone the clone
+ * @param job a job of the clone
  */
-void deleteCases(Node* delete, Node* parent, Node* child, Node* brother)
+void freeClonedItems(RBTree *clone, const CloneJob *job)
 {
-	if(delete->color == RED)
-	{
-		deleteCase1(delete, parent);
-	}
-	else if(child != NULL && delete->color == BLACK && child->color == RED)
+	for(long unsigned i = job->first; i < job->next; i++)
 	{
-		deleteCase2(delete, child, parent);
-	}
-	else
-	{
-		deleteCase3(delete, parent, brother);
-		if(parent->right == delete)
-		{
-			parent->right = NULL;
-		}
-		else
+		Node* node = blockNode(clone, job->block, i);
+		if(node->data != NULL && isInline(clone, node) == 0)
 		{
-			parent->left = NULL;
+			freeData(clone, node->data);
 		}
 	}
-
 }
 
 /**
- * remove an item from the tree
- * @param tree: the tree to remove an item from.
- * @param data: item to remove from the tree.
- * @return: 0 on failure, other on success. (if data is not in the tree - failure).
+ * same as RBTreeClone, but the subtrees below the top levels of the tree are copied by several
+ * threads at once.
+ * @param tree: the tree to copy, it must not be a map.
+ * @param copyFunc: a function to copy an item (may be NULL).
+ * @param numThreads: the number of threads to copy with.
+ * @return: pointer to the copy, NULL on failure.
  */
-int deleteFromRBTree(RBTree *tree, void *data)
+RBTree *RBTreeCloneParallel(const RBTree *tree, CopyFunc copyFunc, unsigned numThreads)
 {
-	if(data == NULL)
+	if(tree == NULL || tree->valueFreeFunc != NULL || numThreads == 0)
 	{
-		return FAIL;
+		return NULL;
 	}
-	if(RBTreeContains(tree, data) == 0)
+	if(numThreads > MAX_CLONE_THREADS)
 	{
-		return FAIL;
+		numThreads = MAX_CLONE_THREADS;
 	}
-	Node* deleteNode = findLocation(tree, data);
-	if(deleteNode->right != NULL && deleteNode->left != NULL)
+	RBTree* clone = (RBTree *) treeAlloc(tree, sizeof(RBTree));
+	if(clone == NULL)
 	{
-		deleteNode = changeWithSuccessor(deleteNode);
+		return NULL;
 	}
-	Node* child = findChild(deleteNode);
-	Node* brother = findBrother(deleteNode);
-	Node* parent = deleteNode->parent;
-	if(parent == NULL)
+	*clone = *tree;
+	clone->root = NULL;
+	clone->bloom = NULL;
+	clone->hotCache = NULL;
+	clone->hashIndex = NULL;
+	clone->blocks = NULL;
+	clone->compaction = NULL;
+	clone->reaping = NULL;
+	if(copyFunc == NULL)
+	{
+		clone->freeFunc = NULL;
+		clone->contextFreeFunc = NULL;
+		// the items are shared, so the changes of the clone must not rewrite their fields.
+		clone->augmentFunc = NULL;
+	}
+	if(tree->root == NULL)
 	{
-		tree->root = child;
-		if(child != NULL)
+		return clone;
+	}
+	NodeBlock* block = (NodeBlock *) treeAlloc(tree, sizeof(NodeBlock));
+	Node* nodes = (Node *) treeAlloc(tree, nodeSize(tree) * tree->size);
+	if(block == NULL || nodes == NULL)
+	{
+		void* allocated[] = {block, nodes, clone};
+		for(int i = 0; i < 3; i++)
 		{
-			child->color = BLACK;
-			child->parent = NULL;
+			if(allocated[i] != NULL)
+			{
+				treeFree(tree, allocated[i]);
+			}
 		}
+		return NULL;
 	}
-	else
+	block->nodes = nodes;
+	block->capacity = tree->size;
+	block->live = tree->size;
+	block->next = NULL;
+	// the top levels are copied here, and every subtree below them is a job of its own thread.
+	unsigned jobDepth = 0;
+	while(numThreads > 1 && (1U << jobDepth) < numThreads)
+	{
+		jobDepth++;
+	}
+	CloneJob top = {tree, clone, block, copyFunc, tree->root, NULL, &clone->root, 0, 0, 0, 0};
+	CloneJob jobs[MAX_CLONE_JOBS];
+	unsigned numJobs = 0;
+	clone->root = copySubtree(&top, tree->root, NULL, 0, jobDepth, jobs, &numJobs);
+	int failed = top.failed;
+	if(failed == 0 && numJobs > 0)
+	{
+		runCloneJobs(jobs, numJobs, countCloneJob);
+		long unsigned first = top.next;
+		for(unsigned i = 0; i < numJobs; i++)
+		{
+			jobs[i].first = first;
+			jobs[i].next = first;
+			first += jobs[i].size;
+		}
+		runCloneJobs(jobs, numJobs, runCloneJob);
+		for(unsigned i = 0; i < numJobs; i++)
+		{
+			failed |= jobs[i].failed;
+		}
+	}
+	if(failed)
 	{
-		deleteCases(deleteNode, parent, child, brother);
-		tree->root = findNewRoot(parent);
+		if(copyFunc != NULL)
+		{
+			freeClonedItems(clone, &top);
+			for(unsigned i = 0; i < numJobs; i++)
+			{
+				freeClonedItems(clone, &jobs[i]);
+			}
+		}
+		treeFree(tree, nodes);
+		treeFree(tree, block);
+		treeFree(tree, clone);
+		return NULL;
 	}
-	tree->freeFunc(deleteNode->data);
-	free(deleteNode);
-	deleteNode = NULL;
-	tree->size--;
-	return SUCCESS;
+	clone->blocks = block;
+	if(copyFunc != NULL && clone->augmentFunc != NULL)
+	{
+		augmentSubtree(clone, clone->root);
+	}
+	return clone;
+}
+
+/**
+ * copy the tree in O(n) with the same shape.
+ * @param tree: the tree to copy, it must not be a map.
+ * @param copyFunc: a function to copy an item (may be NULL).
+ * @return: pointer to the copy, NULL on failure.
+ */
+RBTree *RBTreeClone(const RBTree *tree, CopyFunc copyFunc)
+{
+	return RBTreeCloneParallel(tree, copyFunc, 1);
 }
@@ -1,6 +1,8 @@
 #ifndef RBTREE_RBTREE_H
 #define RBTREE_RBTREE_H
 
+#include <stddef.h>
+
 // a color of a Node.
 typedef enum Color
 {
@@ -22,12 +24,74 @@ typedef int (*CompareFunc)(const void *a, const void *b);
  */
 typedef int (*forEachFunc)(const void *object, void *args);
 
+/**
+ * a function to apply on all items of a counted tree.
+ * @object: a pointer to an item of the tree.
+ * @count: the number of times the item is in the tree.
+ * @args: pointer to other arguments for the function.
+ * @return: 0 on failure, other on success.
+ */
+typedef int (*forEachCountFunc)(const void *object, long unsigned count, void *args);
+
+/**
+ * a function to apply on all pairs of a map.
+ * @key: a pointer to a key of the map.
+ * @value: the value of the key (may be updated in place).
+ * @args: pointer to other arguments for the function.
+ * @return: 0 on failure, other on success.
+ */
+typedef int (*forEachPairFunc)(const void *key, void *value, void *args);
+
 /**
  * a function to free a data item
  * @object: a pointer to an item of the tree.
  */
 typedef void (*FreeFunc)(void *data);
 
+/**
+ * a function to copy a data item
+ * @object: a pointer to an item of the tree.
+ * @return: pointer to the copy, NULL on failure.
+ */
+typedef void *(*CopyFunc)(const void *object);
+
+/**
+ * a function to free a data item of a tree with an allocator
+ * @data: a pointer to an item of the tree.
+ * @context: the context of the tree's allocator.
+ */
+typedef void (*ContextFreeFunc)(void *data, void *context);
+
+/**
+ * the memory functions a tree uses for its nodes and its other internal memory.
+ * alloc: allocates size bytes, returns NULL on failure.
+ * free: frees memory returned by alloc. may be NULL for allocators which release all their memory
+ * at once (e.g. a bump allocator of a request scoped tree).
+ * context: passed to both functions and to the ContextFreeFunc of the tree.
+ */
+typedef struct RBAllocator
+{
+	void *(*alloc)(size_t size, void *context);
+	void (*free)(void *memory, void *context);
+	void *context;
+} RBAllocator;
+
+/**
+ * a hash function for the tree items, equal items must have equal hashes.
+ * @data: a pointer to an item of the tree.
+ * @return: the hash of the item.
+ */
+typedef unsigned long (*HashFunc)(const void *data);
+
+/**
+ * a function to recompute the augmented fields of an item (data the item keeps about the items
+ * under it in the tree, e.g. the maximal endpoint of the intervals of its subtree).
+ * @data: the item to update.
+ * @left, @right: the items of the children of its node (NULL if there is no child), whose augmented
+ * fields are already up to date.
+ */
+typedef void (*AugmentFunc)(void *data, const void *left, const void *right);
+
 /*
  * a node of the tree.
  */
@@ -35,9 +99,30 @@ typedef struct Node
 {
 	struct Node *parent, *left, *right;
 	Color color;
+	unsigned count; // the number of times the item is in a counted tree, 1 otherwise.
 	void *data;
 } Node;
 
+// the kind of an operation of a batch.
+typedef enum BatchOpType
+{
+	BATCH_INSERT, BATCH_DELETE
+} BatchOpType;
+
+/**
+ * an operation of RBTreeApplyBatch: insert an item to the tree or delete an item from it.
+ */
+typedef struct BatchOp
+{
+	BatchOpType type;
+	void *data;
+} BatchOp;
+
+/**
+ * a batch which was sorted and resolved against a tree, with all its memory allocated.
+ */
+typedef struct PreparedBatch PreparedBatch;
+
 /**
  * represents the tree
  */
@@ -46,7 +131,19 @@ typedef struct RBTree
 	Node *root;
 	CompareFunc compFunc;
 	FreeFunc freeFunc;
-	long unsigned size;
+	ContextFreeFunc contextFreeFunc; // used instead of freeFunc by trees with an allocator.
+	FreeFunc valueFreeFunc; // NULL unless the tree is a map.
+	RBAllocator allocator;
+	long unsigned size; // the number of different items.
+	struct BloomFilter *bloom;
+	struct HotCache *hotCache;
+	struct HashIndex *hashIndex; // NULL unless RBTreeAttachHashIndex was called.
+	int counted;
+	struct NodeBlock *blocks; // nodes allocated together by RBTreeCompact and RBTreeClone.
+	struct Compaction *compaction; // NULL unless an RBTreeCompact is in progress.
+	Node *reaping; // the nodes freeRBTreeIncremental has not freed yet.
+	size_t inlineSize; // the size of the key buffer after every node, 0 unless made by newInlineStringRBTree.
+	AugmentFunc augmentFunc; // NULL unless RBTreeAttachAugment was called.
 } RBTree;
 
 /**
@@ -55,22 +152,187 @@ typedef struct RBTree
  */
 RBTree *newRBTree(CompareFunc compFunc, FreeFunc freeFunc); // implement it in RBTree.c
 
+/**
+ * constructs a new RBTree whose nodes (and other internal memory) are allocated by the given allocator.
+ * @param compFunc: a function to compare two items.
+ * @param freeFunc: a function to free an item, it gets the context of the allocator (may be NULL if
+ * the tree does not own its items).
+ * @param allocator: the allocator, it is copied to the tree (the context is not).
+ * @return: pointer to the new tree, NULL on failure.
+ */
+RBTree *newRBTreeWithAllocator(CompareFunc compFunc, ContextFreeFunc freeFunc, const RBAllocator *allocator);
+
+/**
+ * constructs a new counted RBTree (a multiset): inserting an item which is already in the tree
+ * increments its counter in the same descent (the inserted duplicate is freed with freeFunc), and
+ * deleting an item decrements its counter (the item is removed when the counter reaches 0).
+ * @param compFunc: a function to compare two items.
+ * @param freeFunc: a function to free an item.
+ * @return: pointer to the new tree, NULL on failure.
+ */
+RBTree *newCountedRBTree(CompareFunc compFunc, FreeFunc freeFunc);
+
+/**
+ * constructs a new map: a tree of keys where every node also holds a value (in a slot after the
+ * node, which only the nodes of maps have). the map is a regular RBTree of its keys (RBTreeContains, deleteFromRBTree, forEachRBTree, freeRBTree work on the keys,
+ * and deleting or freeing also frees the values).
+ * @param compFunc: a function to compare two keys.
+ * @param keyFreeFunc: a function to free a key.
+ * @param valueFreeFunc: a function to free a value.
+ * @return: pointer to the new map, NULL on failure.
+ */
+RBTree *newRBMap(CompareFunc compFunc, FreeFunc keyFreeFunc, FreeFunc valueFreeFunc);
+
+/**
+ * constructs a new tree of strings whose nodes have a buffer for short keys: an inserted string
+ * which fits in the buffer (with its '\0') is copied into its node and freed right away with
+ * freeFunc, so comparing with it reads the node's own memory instead of a separate allocation.
+ * longer strings are kept by pointer as usual. the items the tree passes out (e.g. to forEachRBTree)
+ * may point into the nodes, so they are valid only until the tree is changed.
+ * @param compFunc: a function to compare two strings (e.g. stringCompare).
+ * @param freeFunc: a function to free a string (may be NULL if the tree does not own its items).
+ * @param inlineSize: the size of the buffer of every node, rounded up to a multiple of the size of a
+ * pointer, at most 64.
+ * @return: pointer to the new tree, NULL on failure.
+ */
+RBTree *newInlineStringRBTree(CompareFunc compFunc, FreeFunc freeFunc, size_t inlineSize);
+
 /**
  * add an item to the tree
  * @param tree: the tree to add an item to.
  * @param data: item to add to the tree.
- * @return: 0 on failure, other on success. (if the item is already in the tree - failure).
+ * @return: 0 on failure, other on success. (if the item is already in the tree - failure, unless
+ * the tree is counted: then its counter is incremented and data is freed with the tree's FreeFunc).
  */
 int insertToRBTree(RBTree *tree, void *data); // implement it in RBTree.c
 
+/**
+ * put a value in the map. if the key is already in the map its value is replaced in place: the old
+ * value is freed with the map's value FreeFunc and the given key with its key FreeFunc.
+ * @param map: the map.
+ * @param key: the key.
+ * @param value: the value.
+ * @return: 0 on failure, other on success.
+ */
+int RBMapPut(RBTree *map, void *key, void *value);
+
+/**
+ * get the value of a key.
+ * @param map: the map.
+ * @param key: the key.
+ * @return: the value of the key, NULL if the key is not in the map.
+ */
+void *RBMapGet(const RBTree *map, const void *key);
+
+/**
+ * get the slot of the value of a key, inserting the key with the given value if it is not in the map.
+ * if the key is already in the map, the given key and value are freed with the map's FreeFuncs.
+ * @param map: the map.
+ * @param key: the key.
+ * @param value: the value to insert if the key is not in the map.
+ * @return: pointer to the value in the map, which may be updated in place. NULL on failure.
+ */
+void **RBMapGetOrInsert(RBTree *map, void *key, void *value);
+
 /**
  * remove an item from the tree
  * @param tree: the tree to remove an item from.
  * @param data: item to remove from the tree.
- * @return: 0 on failure, other on success. (if data is not in the tree - failure).
+ * @return: 0 on failure, other on success. (if data is not in the tree - failure. if the tree is
+ * counted, the counter of the item is decremented and the item is removed when it reaches 0).
  */
 int deleteFromRBTree(RBTree *tree, void *data); // implement it in RBTree.c
 
+/**
+ * add an item to the tree, balancing it in a single pass on the way down (nodes with two red
+ * children are flipped on the way, so no fix up walks back up to the root).
+ * @param tree: the tree to add an item to.
+ * @param data: item to add to the tree.
+ * @return: 0 on failure, other on success. (same as insertToRBTree).
+ */
+int insertToRBTreeTopDown(RBTree *tree, void *data);
+
+/**
+ * remove an item from the tree, balancing it in a single pass on the way down (a red node is
+ * pushed down the search path, so the removed node is red and no fix up walks back up).
+ * @param tree: the tree to remove an item from.
+ * @param data: item to remove from the tree.
+ * @return: 0 on failure, other on success. (same as deleteFromRBTree).
+ */
+int deleteFromRBTreeTopDown(RBTree *tree, void *data);
+
+/**
+ * remove all the items a predicate selects, in O(n): one in order sweep calls the predicate on
+ * every item and frees the selected items (with the tree's FreeFuncs), and the rest are relinked to
+ * a balanced tree instead of being deleted one by one.
+ * @param tree: the tree to remove items from.
+ * @param predicate: returns other than 0 for an item to remove, 0 for an item to keep.
+ * @param args: more optional arguments to the predicate (may be null if the predicate support it).
+ * @return: 0 on failure (the tree is not changed), other on success.
+ */
+int RBTreeRemoveIf(RBTree *tree, forEachFunc predicate, void *args);
+
+/**
+ * fill an empty tree with sorted items in O(n): the nodes are allocated in one block and linked to
+ * a balanced tree directly, instead of inserting the items one by one (e.g. to load a snapshot).
+ * @param tree: an empty tree, not a map.
+ * @param items: the items in a strictly ascending order, the tree owns them on success.
+ * @param n: the number of items.
+ * @return: 0 on failure (the tree is left empty and the items are not taken), other on success.
+ */
+int RBTreeBulkLoad(RBTree *tree, void *const *items, long unsigned n);
+
+/**
+ * remove all the items between two bounds (including the bounds), by splitting the range out of
+ * the tree and joining the rest back, so the cost is O(log n) plus freeing the removed items
+ * (with the tree's FreeFuncs) instead of a delete for every item.
+ * @param tree: the tree to remove items from.
+ * @param lo: the lowest item to remove (it does not have to be in the tree).
+ * @param hi: the highest item to remove (it does not have to be in the tree).
+ * @return: 0 on failure (e.g. lo is higher than hi), other on success.
+ */
+int RBTreeDeleteRange(RBTree *tree, const void *lo, const void *hi);
+
+/**
+ * apply a batch of inserts and deletes, with the same results as applying them one by one in the
+ * given order. the batch is sorted (operations on the same item keep their order) and resolved to
+ * one change per item before the tree is touched, then small batches are hanged node by node and
+ * large ones are merged with the tree in one pass and rebuilt in O(n).
+ * all the memory is allocated first, so either the whole batch is applied or nothing is.
+ * @param tree: the tree, not a map and not counted.
+ * @param ops: the operations.
+ * @param n: the number of operations.
+ * @param results: may be NULL. else an array of n ints, results[i] is set to 0 if ops[i] failed
+ * (an insert of an item which was in the tree, and then it still belongs to the caller, or a delete
+ * of an item which was not), other if it succeeded.
+ * @return: 0 on failure (the tree is not changed and no item is taken), other on success.
+ */
+int RBTreeApplyBatch(RBTree *tree, const BatchOp *ops, long unsigned n, int *results);
+
+/**
+ * the first step of RBTreeApplyBatch: sort and resolve the batch and allocate its memory, without
+ * changing the tree. the tree must not be changed until the batch is committed or aborted, so a
+ * caller can prepare batches of several trees and commit all of them only if all were prepared.
+ * @param tree: the tree, not a map and not counted.
+ * @param ops: the operations, they must stay valid until the batch is committed or aborted.
+ * @param n: the number of operations.
+ * @return: the prepared batch, NULL on failure.
+ */
+PreparedBatch *RBTreePrepareBatch(RBTree *tree, const BatchOp *ops, long unsigned n);
+
+/**
+ * apply a prepared batch to its tree and free it. it cannot fail.
+ * @param batch: pointer to the prepared batch.
+ * @param results: the same as the results of RBTreeApplyBatch.
+ */
+void RBTreeCommitBatch(PreparedBatch **batch, int *results);
+
+/**
+ * free a prepared batch without applying it.
+ * @param batch: pointer to the prepared batch.
+ */
+void RBTreeAbortBatch(PreparedBatch **batch);
+
 /**
  * check whether the tree RBTreeContains this item.
  * @param tree: the tree to add an item to.
@@ -79,7 +341,76 @@ int deleteFromRBTree(RBTree *tree, void *data); // implement it in RBTree.c
  */
 int RBTreeContains(const RBTree *tree, const void *data); // implement it in RBTree.c
 
+/**
+ * check for many items at once whether the tree contains them. the lookups descend the tree
+ * together and prefetch their next nodes, which is much faster than calling RBTreeContains for
+ * each item when the tree does not fit in the cache.
+ * @param tree: the tree to search in.
+ * @param keys: the items to check (a NULL item is reported as not in the tree).
+ * @param n: the number of items.
+ * @param results: an array of n ints, results[i] is set to 0 if keys[i] is not in the tree, other if it is.
+ * @return: 0 on failure, other on success.
+ */
+int RBTreeContainsBatch(const RBTree *tree, const void *const *keys, long unsigned n, int *results);
+
+
+
+/**
+ * attach a counting Bloom filter to the tree. lookups of items which are not in the tree are then
+ * usually rejected by a few probes of one cache line instead of a full descent. the filter is kept
+ * in sync by insertToRBTree and deleteFromRBTree and is freed with the tree.
+ * @param tree: the tree to attach the filter to (the items already in it are added to the filter).
+ * @param hashFunc: a hash function for the items of the tree.
+ * @param expectedItems: the number of items the tree is expected to hold, used to size the filter.
+ * @return: 0 on failure, other on success.
+ */
+int RBTreeAttachBloomFilter(RBTree *tree, HashFunc hashFunc, long unsigned expectedItems);
+
+/**
+ * attach a small direct mapped cache in front of the tree. items found by RBTreeContains are kept
+ * in the entry of their hash, so repeated lookups of hot items skip the descent. deleting an item
+ * removes its entry (inserts cannot make an entry wrong). the cache is updated by RBTreeContains,
+ * so a tree with a cache must not be searched by several threads at once.
+ * @param tree: the tree to attach the cache to.
+ * @param hashFunc: a hash function for the items of the tree.
+ * @param slots: the number of entries of the cache (rounded up to a power of 2).
+ * @return: 0 on failure, other on success.
+ */
+int RBTreeAttachHotCache(RBTree *tree, HashFunc hashFunc, long unsigned slots);
+
+/**
+ * get the counters of the cache of the tree, to tune its size.
+ * @param tree: the tree.
+ * @param hits: where to write the number of lookups answered by the cache.
+ * @param misses: where to write the number of lookups which descended the tree.
+ * @return: 0 on failure (e.g. the tree has no cache), other on success.
+ */
+int getHotCacheStats(const RBTree *tree, long unsigned *hits, long unsigned *misses);
+
+/**
+ * attach an open addressing hash index from the items of the tree to their nodes. exact lookups
+ * (RBTreeContains, RBTreeCount, RBMapGet and the search of deleteFromRBTree) then take O(1) expected
+ * instead of a descent, while the tree keeps its order for forEachRBTree. the index is kept up to
+ * date by all the operations of the tree. if it cannot grow when the tree grows, it is dropped and
+ * the lookups descend the tree again.
+ * @param tree: the tree to attach the index to (the items already in it are indexed).
+ * @param hashFunc: a hash function for the items of the tree, equal items must have equal hashes
+ * (e.g. hashString for a tree of stringCompare).
+ * @return: 0 on failure, other on success.
+ */
+int RBTreeAttachHashIndex(RBTree *tree, HashFunc hashFunc);
 
+/**
+ * keep augmented fields in the items of the tree. every operation which changes the shape of the
+ * tree (inserts, deletes and their rotations, batches, rebuilds and splits) recomputes the fields
+ * of the nodes it changed and of the nodes above them, so after every operation the fields of
+ * every item describe its subtree. walks of the tree can then skip whole subtrees by them.
+ * @param tree: the tree, not a tree with key buffers (the fields of the items already in it are
+ * computed).
+ * @param augmentFunc: the function which recomputes the fields of an item.
+ * @return: 0 on failure, other on success.
+ */
+int RBTreeAttachAugment(RBTree *tree, AugmentFunc augmentFunc);
 
 /**
  * Activate a function on each item of the tree. the order is an ascending order. if one of the activations of the
@@ -92,10 +423,86 @@ int RBTreeContains(const RBTree *tree, const void *data); // implement it in RBT
 int forEachRBTree(const RBTree *tree, forEachFunc func, void *args); // implement it in RBTree.c
 
 /**
- * free all memory of the data structure.
+ * Activate a function on each item of the tree and its counter. the order is an ascending order.
+ * if one of the activations of the function returns 0, the process stops.
+ * @param tree: the tree with all the items.
+ * @param func: the function to activate on all items.
+ * @param args: more optional arguments to the function (may be null if the given function support it).
+ * @return: 0 on failure, other on success.
+ */
+int forEachCountedRBTree(const RBTree *tree, forEachCountFunc func, void *args);
+
+/**
+ * get the counter of an item.
+ * @param tree: the tree to search in.
+ * @param data: the item.
+ * @return: the number of times the item is in the tree (0 if it is not in the tree).
+ */
+long unsigned RBTreeCount(const RBTree *tree, const void *data);
+
+/**
+ * Activate a function on each key of the map and its value. the order is an ascending order of the
+ * keys. if one of the activations of the function returns 0, the process stops.
+ * @param map: the map.
+ * @param func: the function to activate on all pairs.
+ * @param args: more optional arguments to the function (may be null if the given function support it).
+ * @return: 0 on failure, other on success.
+ */
+int forEachRBMap(const RBTree *map, forEachPairFunc func, void *args);
+
+/**
+ * relocate the nodes of the tree, in order, to one contiguous block, so walking the tree in order
+ * reads the memory sequentially instead of jumping around the heap. the work may be split to bounded
+ * steps (e.g. during idle periods): the tree may be used and changed between the calls, and the
+ * compaction continues from where it stopped. the items themselves are not moved.
+ * @param tree: the tree to compact.
+ * @param budget: the maximal number of nodes to relocate in this call, 0 for no limit.
+ * @param finished: set to 1 if the compaction is complete, 0 if more calls are needed.
+ * @return: 0 on failure, other on success.
+ */
+int RBTreeCompact(RBTree *tree, long unsigned budget, int *finished);
+
+/**
+ * copy the tree in O(n): every node is copied with its color and counter to one block of nodes
+ * allocated for the whole copy, so the copy has the same shape and no insert is done. the Bloom
+ * filter, the hot cache and the hash index are not copied.
+ * @param tree: the tree to copy, it must not be a map.
+ * @param copyFunc: a function to copy an item, the copy owns the copied items and frees them with
+ * the tree's FreeFunc. may be NULL, then the copy shares the items of the tree and does not free them,
+ * and the copy of an augmented tree is not augmented (its changes would rewrite the fields of the
+ * items of the tree).
+ * @return: pointer to the copy, NULL on failure.
+ */
+RBTree *RBTreeClone(const RBTree *tree, CopyFunc copyFunc);
+
+/**
+ * same as RBTreeClone, but the subtrees below the top levels of the tree are copied by several
+ * threads at once. copyFunc is called from these threads, so it must be thread safe, and the tree
+ * must not be changed meanwhile.
+ * @param tree: the tree to copy, it must not be a map.
+ * @param copyFunc: a function to copy an item (may be NULL, see RBTreeClone).
+ * @param numThreads: the number of threads to copy with, 1 to copy in the calling thread only.
+ * @return: pointer to the copy, NULL on failure.
+ */
+RBTree *RBTreeCloneParallel(const RBTree *tree, CopyFunc copyFunc, unsigned numThreads);
+
+/**
+ * free all memory of the data structure. a tree without FreeFuncs whose allocator has no free
+ * function (e.g. a tree of interned strings whose nodes come from the same StringArena) is freed
+ * in O(1), without visiting its nodes.
  * @param tree: pointer to the tree to free.
  */
 void freeRBTree(RBTree **tree); // implement it in RBTree.c
 
+/**
+ * free the tree in bounded steps, so a large tree can be freed during idle ticks, or handed to
+ * another thread to free. the first call detaches all the nodes from the tree in O(1) (the tree is
+ * empty from then on and must not be changed), and every call frees at most budget nodes.
+ * @param tree: pointer to the tree to free, set to NULL when all its memory was freed.
+ * @param budget: the maximal number of nodes to free in this call, 0 for no limit.
+ * @return: 0 on failure, other on success.
+ */
+int freeRBTreeIncremental(RBTree **tree, long unsigned budget);
+
 
 #endif //RBTREE_RBTREE_H
\ No newline at end of file
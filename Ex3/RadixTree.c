@@ -0,0 +1,850 @@
+#include <string.h>
+#include <stdlib.h>
+#include "RadixTree.h"
+
+#define FAIL 0
+#define SUCCESS 1
+#define NODE48_EMPTY 0
+#define SHRINK_NODE256 37
+#define SHRINK_NODE48 12
+#define SHRINK_NODE16 3
+
+/**
+ * the types of the nodes, an inner node of every type can hold more children than the type before.
+ */
+typedef enum RadixNodeType
+{
+	LEAF, NODE4, NODE16, NODE48, NODE256
+} RadixNodeType;
+
+/**
+ * the common beginning of all the nodes.
+ */
+typedef struct RadixNode
+{
+	unsigned char type;
+} RadixNode;
+
+/**
+ * a node of a single item. the bytes of the item below the leaf are not stored in the tree, they
+ * are compared to the searched item when the leaf is reached.
+ */
+typedef struct RadixLeaf
+{
+	RadixNode header;
+	void *item;
+} RadixLeaf;
+
+/**
+ * the common beginning of the inner nodes. the prefix holds the bytes which all the items below
+ * the node share after the byte of the edge to the node, so the node is reached only after them.
+ * the terminating '\0' of an item is a key byte like any other, so no item is a prefix of another,
+ * and a prefix never contains '\0'.
+ */
+typedef struct RadixInner
+{
+	RadixNode header;
+	unsigned short count;
+	long unsigned prefixLength;
+	unsigned char *prefix;
+} RadixInner;
+
+/**
+ * an inner node of up to 4 children, sorted by their key bytes.
+ */
+typedef struct Node4
+{
+	RadixInner inner;
+	unsigned char keys[4];
+	RadixNode *children[4];
+} Node4;
+
+/**
+ * an inner node of up to 16 children, sorted by their key bytes.
+ */
+typedef struct Node16
+{
+	RadixInner inner;
+	unsigned char keys[16];
+	RadixNode *children[16];
+} Node16;
+
+/**
+ * an inner node of up to 48 children. index maps a key byte to its child slot + 1 (NODE48_EMPTY if
+ * the byte has no child).
+ */
+typedef struct Node48
+{
+	RadixInner inner;
+	unsigned char index[256];
+	RadixNode *children[48];
+} Node48;
+
+/**
+ * an inner node with a child slot for every key byte.
+ */
+typedef struct Node256
+{
+	RadixInner inner;
+	RadixNode *children[256];
+} Node256;
+
+/**
+ * the maximal number of children of an inner node type
+ * @param type the type
+ * @return the number of children
+ */
+unsigned capacityOf(unsigned char type)
+{
+	switch(type)
+	{
+		case NODE4:
+			return 4;
+		case NODE16:
+			return 16;
+		case NODE48:
+			return 48;
+		default:
+			return 256;
+	}
+}
+
+/**
+ * allocates an empty inner node without a prefix
+ * @param type the type of the node
+ * @return pointer to the node, NULL on failure
+ */
+RadixInner *newInner(unsigned char type)
+{
+	size_t size = sizeof(Node256);
+	switch(type)
+	{
+		case NODE4:
+			size = sizeof(Node4);
+			break;
+		case NODE16:
+			size = sizeof(Node16);
+			break;
+		case NODE48:
+			size = sizeof(Node48);
+			break;
+		default:
+			break;
+	}
+	RadixInner* node = (RadixInner *) calloc(1, size);
+	if(node == NULL)
+	{
+		return NULL;
+	}
+	node->header.type = type;
+	return node;
+}
+
+/**
+ * frees an inner node and its prefix (not its children)
+ * @param node the node
+ */
+void freeInner(RadixInner *node)
+{
+	free(node->prefix);
+	free(node);
+}
+
+/**
+ * replaces the prefix of a node with a copy of the given bytes
+ * @param node the node
+ * @param bytes the bytes of the prefix (may be a part of the current prefix)
+ * @param length the number of bytes
+ * @return 0 on failure (the prefix is not changed), 1 on success
+ */
+int setPrefix(RadixInner *node, const unsigned char *bytes, long unsigned length)
+{
+	unsigned char* prefix = NULL;
+	if(length > 0)
+	{
+		prefix = (unsigned char *) malloc(length);
+		if(prefix == NULL)
+		{
+			return FAIL;
+		}
+		memcpy(prefix, bytes, length);
+	}
+	free(node->prefix);
+	node->prefix = prefix;
+	node->prefixLength = length;
+	return SUCCESS;
+}
+
+/**
+ * finds the number of bytes of the prefix of a node that the key matches
+ * @param node the node
+ * @param key the key
+ * @param depth the index in the key of the first byte of the prefix
+ * @return the number of matching bytes, the length of the prefix if all of it matches
+ */
+long unsigned prefixMismatch(const RadixInner *node, const unsigned char *key, long unsigned depth)
+{
+	for(long unsigned i = 0; i < node->prefixLength; i++)
+	{
+		// the prefix has no '\0', so this stops at the end of the key at the latest.
+		if(node->prefix[i] != key[depth + i])
+		{
+			return i;
+		}
+	}
+	return node->prefixLength;
+}
+
+/**
+ * checks whether a leaf holds the key. the bytes before depth are known to be equal.
+ * @param leaf the leaf
+ * @param key the key
+ * @param depth the number of bytes consumed on the way to the leaf
+ * @return 1 if the leaf holds the key, else 0
+ */
+int leafMatches(const RadixLeaf *leaf, const unsigned char *key, long unsigned depth)
+{
+	if(depth > 0 && key[depth - 1] == '\0')
+	{
+		return SUCCESS;
+	}
+	return strcmp((const char *) leaf->item + depth, (const char *) key + depth) == 0;
+}
+
+/**
+ * finds the slot of the child of a key byte
+ * @param node the node
+ * @param byte the key byte
+ * @return pointer to the slot of the child, NULL if the byte has no child
+ */
+RadixNode **findRadixChild(RadixInner *node, unsigned char byte)
+{
+	unsigned char* keys = NULL;
+	RadixNode** children = NULL;
+	switch(node->header.type)
+	{
+		case NODE4:
+			keys = ((Node4 *) node)->keys;
+			children = ((Node4 *) node)->children;
+			break;
+		case NODE16:
+			keys = ((Node16 *) node)->keys;
+			children = ((Node16 *) node)->children;
+			break;
+		case NODE48:
+		{
+			Node48* node48 = (Node48 *) node;
+			if(node48->index[byte] == NODE48_EMPTY)
+			{
+				return NULL;
+			}
+			return node48->children + node48->index[byte] - 1;
+		}
+		default:
+		{
+			RadixNode** slot = ((Node256 *) node)->children + byte;
+			return *slot == NULL ? NULL : slot;
+		}
+	}
+	for(unsigned i = 0; i < node->count && keys[i] <= byte; i++)
+	{
+		if(keys[i] == byte)
+		{
+			return children + i;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * iterates over the children of a node in an ascending order of their key bytes
+ * @param node the node
+ * @param position the position of the iteration, 0 at the beginning, advanced by the call
+ * @param byte where to write the key byte of the child
+ * @return the next child, NULL if there are no more children
+ */
+RadixNode *nextChild(const RadixInner *node, unsigned *position, unsigned char *byte)
+{
+	switch(node->header.type)
+	{
+		case NODE4:
+		case NODE16:
+		{
+			if(*position >= node->count)
+			{
+				return NULL;
+			}
+			unsigned i = (*position)++;
+			if(node->header.type == NODE4)
+			{
+				*byte = ((const Node4 *) node)->keys[i];
+				return ((const Node4 *) node)->children[i];
+			}
+			*byte = ((const Node16 *) node)->keys[i];
+			return ((const Node16 *) node)->children[i];
+		}
+		case NODE48:
+		{
+			const Node48* node48 = (const Node48 *) node;
+			while(*position < 256)
+			{
+				unsigned b = (*position)++;
+				if(node48->index[b] != NODE48_EMPTY)
+				{
+					*byte = (unsigned char) b;
+					return node48->children[node48->index[b] - 1];
+				}
+			}
+			return NULL;
+		}
+		default:
+		{
+			const Node256* node256 = (const Node256 *) node;
+			while(*position < 256)
+			{
+				unsigned b = (*position)++;
+				if(node256->children[b] != NULL)
+				{
+					*byte = (unsigned char) b;
+					return node256->children[b];
+				}
+			}
+			return NULL;
+		}
+	}
+}
+
+/**
+ * adds a child to a node which has room for it
+ * @param node the node
+ * @param byte the key byte of the child, it has no child yet
+ * @param child the child
+ */
+void insertChild(RadixInner *node, unsigned char byte, RadixNode *child)
+{
+	unsigned char* keys = NULL;
+	RadixNode** children = NULL;
+	switch(node->header.type)
+	{
+		case NODE4:
+			keys = ((Node4 *) node)->keys;
+			children = ((Node4 *) node)->children;
+			break;
+		case NODE16:
+			keys = ((Node16 *) node)->keys;
+			children = ((Node16 *) node)->children;
+			break;
+		case NODE48:
+		{
+			Node48* node48 = (Node48 *) node;
+			unsigned slot = 0;
+			while(node48->children[slot] != NULL)
+			{
+				slot++;
+			}
+			node48->children[slot] = child;
+			node48->index[byte] = (unsigned char) (slot + 1);
+			node->count++;
+			return;
+		}
+		default:
+			((Node256 *) node)->children[byte] = child;
+			node->count++;
+			return;
+	}
+	unsigned i = node->count;
+	while(i > 0 && keys[i - 1] > byte)
+	{
+		keys[i] = keys[i - 1];
+		children[i] = children[i - 1];
+		i--;
+	}
+	keys[i] = byte;
+	children[i] = child;
+	node->count++;
+}
+
+/**
+ * removes a child from a node
+ * @param node the node
+ * @param byte the key byte of the child
+ */
+void eraseChild(RadixInner *node, unsigned char byte)
+{
+	unsigned char* keys = NULL;
+	RadixNode** children = NULL;
+	switch(node->header.type)
+	{
+		case NODE4:
+			keys = ((Node4 *) node)->keys;
+			children = ((Node4 *) node)->children;
+			break;
+		case NODE16:
+			keys = ((Node16 *) node)->keys;
+			children = ((Node16 *) node)->children;
+			break;
+		case NODE48:
+		{
+			Node48* node48 = (Node48 *) node;
+			node48->children[node48->index[byte] - 1] = NULL;
+			node48->index[byte] = NODE48_EMPTY;
+			node->count--;
+			return;
+		}
+		default:
+			((Node256 *) node)->children[byte] = NULL;
+			node->count--;
+			return;
+	}
+	unsigned i = 0;
+	while(keys[i] != byte)
+	{
+		i++;
+	}
+	for(; i + 1 < node->count; i++)
+	{
+		keys[i] = keys[i + 1];
+		children[i] = children[i + 1];
+	}
+	node->count--;
+}
+
+/**
+ * moves a node to a new node of another type, which has room for all its children
+ * @param node the node, it is freed on success
+ * @param type the new type
+ * @return the new node, NULL on failure (the node is not changed)
+ */
+RadixInner *resizeInner(RadixInner *node, unsigned char type)
+{
+	RadixInner* resized = newInner(type);
+	if(resized == NULL)
+	{
+		return NULL;
+	}
+	resized->prefix = node->prefix;
+	resized->prefixLength = node->prefixLength;
+	unsigned position = 0;
+	unsigned char byte = 0;
+	RadixNode* child = NULL;
+	while((child = nextChild(node, &position, &byte)) != NULL)
+	{
+		insertChild(resized, byte, child);
+	}
+	free(node);
+	return resized;
+}
+
+/**
+ * adds a child to the node in the slot, growing the node if it is full
+ * @param slot the slot of the node
+ * @param byte the key byte of the child, it has no child yet
+ * @param child the child
+ * @return 0 on failure, 1 on success
+ */
+int addChild(RadixNode **slot, unsigned char byte, RadixNode *child)
+{
+	RadixInner* node = (RadixInner *) *slot;
+	if(node->count == capacityOf(node->header.type))
+	{
+		node = resizeInner(node, (unsigned char) (node->header.type + 1));
+		if(node == NULL)
+		{
+			return FAIL;
+		}
+		*slot = (RadixNode *) node;
+	}
+	insertChild(node, byte, child);
+	return SUCCESS;
+}
+
+/**
+ * replaces a node which has a single child with the child, adding the node's prefix and the key
+ * byte of the child to the prefix of the child. if memory for the new prefix cannot be allocated
+ * the node is kept, a node with a single child is still a valid node.
+ * @param slot the slot of the node
+ */
+void collapseNode(RadixNode **slot)
+{
+	RadixInner* node = (RadixInner *) *slot;
+	unsigned position = 0;
+	unsigned char byte = 0;
+	RadixNode* child = nextChild(node, &position, &byte);
+	if(child->type != LEAF)
+	{
+		RadixInner* inner = (RadixInner *) child;
+		long unsigned length = node->prefixLength + 1 + inner->prefixLength;
+		unsigned char* prefix = (unsigned char *) malloc(length);
+		if(prefix == NULL)
+		{
+			return;
+		}
+		if(node->prefixLength > 0)
+		{
+			memcpy(prefix, node->prefix, node->prefixLength);
+		}
+		prefix[node->prefixLength] = byte;
+		if(inner->prefixLength > 0)
+		{
+			memcpy(prefix + node->prefixLength + 1, inner->prefix, inner->prefixLength);
+		}
+		free(inner->prefix);
+		inner->prefix = prefix;
+		inner->prefixLength = length;
+	}
+	*slot = child;
+	freeInner(node);
+}
+
+/**
+ * removes a child from the node in the slot, shrinking the node if it gets sparse (if memory for
+ * the smaller node cannot be allocated the node keeps its size)
+ * @param slot the slot of the node
+ * @param byte the key byte of the child
+ */
+void removeChild(RadixNode **slot, unsigned char byte)
+{
+	RadixInner* node = (RadixInner *) *slot;
+	eraseChild(node, byte);
+	RadixInner* resized = NULL;
+	switch(node->header.type)
+	{
+		case NODE4:
+			if(node->count == 1)
+			{
+				collapseNode(slot);
+			}
+			return;
+		case NODE16:
+			if(node->count <= SHRINK_NODE16)
+			{
+				resized = resizeInner(node, NODE4);
+			}
+			break;
+		case NODE48:
+			if(node->count <= SHRINK_NODE48)
+			{
+				resized = resizeInner(node, NODE16);
+			}
+			break;
+		default:
+			if(node->count <= SHRINK_NODE256)
+			{
+				resized = resizeInner(node, NODE48);
+			}
+			break;
+	}
+	if(resized != NULL)
+	{
+		*slot = (RadixNode *) resized;
+	}
+}
+
+/**
+ * hangs a new leaf below the node in the slot
+ * @param slot the slot to start from
+ * @param leaf the new leaf
+ * @param depth the number of bytes of the key consumed on the way to the slot
+ * @return 0 on failure (e.g. the item is already in the tree), 1 on success
+ */
+int insertLeaf(RadixNode **slot, RadixLeaf *leaf, long unsigned depth)
+{
+	const unsigned char* key = (const unsigned char *) leaf->item;
+	while(*slot != NULL && (*slot)->type != LEAF)
+	{
+		RadixInner* node = (RadixInner *) *slot;
+		long unsigned matched = prefixMismatch(node, key, depth);
+		if(matched < node->prefixLength)
+		{
+			// the key leaves the prefix in the middle, split the prefix by a new node.
+			RadixInner* split = newInner(NODE4);
+			if(split == NULL || setPrefix(split, node->prefix, matched) == 0)
+			{
+				free(split);
+				return FAIL;
+			}
+			unsigned char byte = node->prefix[matched];
+			node->prefixLength -= matched + 1;
+			memmove(node->prefix, node->prefix + matched + 1, node->prefixLength);
+			insertChild(split, byte, (RadixNode *) node);
+			insertChild(split, key[depth + matched], (RadixNode *) leaf);
+			*slot = (RadixNode *) split;
+			return SUCCESS;
+		}
+		depth += node->prefixLength;
+		RadixNode** child = findRadixChild(node, key[depth]);
+		if(child == NULL)
+		{
+			return addChild(slot, key[depth], (RadixNode *) leaf);
+		}
+		slot = child;
+		depth++;
+	}
+	if(*slot == NULL)
+	{
+		*slot = (RadixNode *) leaf;
+		return SUCCESS;
+	}
+	RadixLeaf* other = (RadixLeaf *) *slot;
+	if(leafMatches(other, key, depth))
+	{
+		return FAIL;
+	}
+	// two different items, one of them may end first but then its '\0' is where they differ.
+	const unsigned char* otherKey = (const unsigned char *) other->item;
+	long unsigned end = depth;
+	while(otherKey[end] == key[end])
+	{
+		end++;
+	}
+	RadixInner* split = newInner(NODE4);
+	if(split == NULL || setPrefix(split, key + depth, end - depth) == 0)
+	{
+		free(split);
+		return FAIL;
+	}
+	insertChild(split, otherKey[end], (RadixNode *) other);
+	insertChild(split, key[end], (RadixNode *) leaf);
+	*slot = (RadixNode *) split;
+	return SUCCESS;
+}
+
+/**
+ * frees a leaf and its item
+ * @param tree the tree
+ * @param leaf the leaf
+ */
+void freeLeaf(const RadixTree *tree, RadixLeaf *leaf)
+{
+	if(tree->freeFunc != NULL)
+	{
+		tree->freeFunc(leaf->item);
+	}
+	free(leaf);
+}
+
+/**
+ * frees a subtree and its items
+ * @param tree the tree
+ * @param node the root of the subtree
+ */
+void freeRadixNodes(const RadixTree *tree, RadixNode *node)
+{
+	if(node->type == LEAF)
+	{
+		freeLeaf(tree, (RadixLeaf *) node);
+		return;
+	}
+	unsigned position = 0;
+	unsigned char byte = 0;
+	RadixNode* child = NULL;
+	while((child = nextChild((RadixInner *) node, &position, &byte)) != NULL)
+	{
+		freeRadixNodes(tree, child);
+	}
+	freeInner((RadixInner *) node);
+}
+
+/**
+ * in order walk on a subtree
+ * @param node the root of the subtree
+ * @param func the func to apply on the items
+ * @param args extra args
+ * @return 0 if the func failed, else 1
+ */
+int forEachRadixHelper(const RadixNode *node, forEachFunc func, void *args)
+{
+	if(node->type == LEAF)
+	{
+		return func(((const RadixLeaf *) node)->item, args) != 0;
+	}
+	unsigned position = 0;
+	unsigned char byte = 0;
+	const RadixNode* child = NULL;
+	while((child = nextChild((const RadixInner *) node, &position, &byte)) != NULL)
+	{
+		if(forEachRadixHelper(child, func, args) == 0)
+		{
+			return FAIL;
+		}
+	}
+	return SUCCESS;
+}
+
+/**
+ * constructs a new radix tree.
+ * @param freeFunc: a function to free an item (may be NULL if the tree does not own its items).
+ * @return: pointer to the new tree, NULL on failure.
+ */
+RadixTree *newRadixTree(FreeFunc freeFunc)
+{
+	RadixTree* tree = (RadixTree *) malloc(sizeof(RadixTree));
+	if(tree == NULL)
+	{
+		return NULL;
+	}
+	tree->root = NULL;
+	tree->freeFunc = freeFunc;
+	tree->size = 0;
+	return tree;
+}
+
+/**
+ * add an item to the tree
+ * @param tree: the tree to add an item to.
+ * @param data: item to add to the tree, a string.
+ * @return: 0 on failure, other on success. (if the item is already in the tree - failure).
+ */
+int insertToRadixTree(RadixTree *tree, void *data)
+{
+	if(tree == NULL || data == NULL)
+	{
+		return FAIL;
+	}
+	RadixLeaf* leaf = (RadixLeaf *) malloc(sizeof(RadixLeaf));
+	if(leaf == NULL)
+	{
+		return FAIL;
+	}
+	leaf->header.type = LEAF;
+	leaf->item = data;
+	if(insertLeaf(&tree->root, leaf, 0) == 0)
+	{
+		free(leaf);
+		return FAIL;
+	}
+	tree->size++;
+	return SUCCESS;
+}
+
+/**
+ * remove an item from the tree
+ * @param tree: the tree to remove an item from.
+ * @param data: item to remove from the tree.
+ * @return: 0 on failure, other on success. (if data is not in the tree - failure).
+ */
+int deleteFromRadixTree(RadixTree *tree, void *data)
+{
+	if(tree == NULL || data == NULL || tree->root == NULL)
+	{
+		return FAIL;
+	}
+	const unsigned char* key = (const unsigned char *) data;
+	if(tree->root->type == LEAF)
+	{
+		if(leafMatches((RadixLeaf *) tree->root, key, 0) == 0)
+		{
+			return FAIL;
+		}
+		freeLeaf(tree, (RadixLeaf *) tree->root);
+		tree->root = NULL;
+		tree->size--;
+		return SUCCESS;
+	}
+	RadixNode** slot = &tree->root;
+	long unsigned depth = 0;
+	while(1)
+	{
+		RadixInner* node = (RadixInner *) *slot;
+		if(prefixMismatch(node, key, depth) < node->prefixLength)
+		{
+			return FAIL;
+		}
+		depth += node->prefixLength;
+		RadixNode** child = findRadixChild(node, key[depth]);
+		if(child == NULL)
+		{
+			return FAIL;
+		}
+		if((*child)->type == LEAF)
+		{
+			RadixLeaf* leaf = (RadixLeaf *) *child;
+			if(leafMatches(leaf, key, depth + 1) == 0)
+			{
+				return FAIL;
+			}
+			removeChild(slot, key[depth]);
+			freeLeaf(tree, leaf);
+			tree->size--;
+			return SUCCESS;
+		}
+		slot = child;
+		depth++;
+	}
+}
+
+/**
+ * check whether the tree contains this item.
+ * @param tree: the tree to search in.
+ * @param data: item to check.
+ * @return: 0 if the item is not in the tree, other if it is.
+ */
+int radixTreeContains(const RadixTree *tree, const void *data)
+{
+	if(tree == NULL || data == NULL)
+	{
+		return FAIL;
+	}
+	const unsigned char* key = (const unsigned char *) data;
+	RadixNode* node = tree->root;
+	long unsigned depth = 0;
+	while(node != NULL && node->type != LEAF)
+	{
+		RadixInner* inner = (RadixInner *) node;
+		if(prefixMismatch(inner, key, depth) < inner->prefixLength)
+		{
+			return FAIL;
+		}
+		depth += inner->prefixLength;
+		RadixNode** child = findRadixChild(inner, key[depth]);
+		if(child == NULL)
+		{
+			return FAIL;
+		}
+		node = *child;
+		depth++;
+	}
+	return node != NULL && leafMatches((const RadixLeaf *) node, key, depth);
+}
+
+/**
+ * Activate a function on each item of the tree. the order is the ascending order of stringCompare.
+ * if one of the activations of the function returns 0, the process stops.
+ * @param tree: the tree with all the items.
+ * @param func: the function to activate on all items.
+ * @param args: more optional arguments to the function (may be null if the given function support it).
+ * @return: 0 on failure, other on success.
+ */
+int forEachRadixTree(const RadixTree *tree, forEachFunc func, void *args)
+{
+	if(tree == NULL || func == NULL)
+	{
+		return FAIL;
+	}
+	if(tree->root == NULL)
+	{
+		return SUCCESS;
+	}
+	return forEachRadixHelper(tree->root, func, args);
+}
+
+/**
+ * free all memory of the data structure.
+ * @param tree: pointer to the tree to free.
+ */
+void freeRadixTree(RadixTree **tree)
+{
+	if(tree == NULL)
+	{
+		return;
+	}
+	if(*tree != NULL)
+	{
+		if((*tree)->root != NULL)
+		{
+			freeRadixNodes(*tree, (*tree)->root);
+		}
+		free(*tree);
+	}
+	*tree = NULL;
+}
@@ -0,0 +1,68 @@
+#ifndef RBTREE_RADIXTREE_H
+#define RBTREE_RADIXTREE_H
+
+#include "RBTree.h"
+
+/**
+ * a set of strings kept in an adaptive radix tree (ART) instead of a red black tree. every level
+ * consumes one byte of the key, so a lookup compares every byte of the key once (instead of a whole
+ * strcmp on every level), and keys with a common prefix share the nodes of the prefix. inner nodes
+ * hold 4, 16, 48 or 256 children and change their size as children are added and removed, and
+ * chains of nodes with a single child are compressed to a prefix.
+ * the items are strings (char*), and the order of the tree is the order of stringCompare.
+ */
+typedef struct RadixTree
+{
+	struct RadixNode *root;
+	FreeFunc freeFunc;
+	long unsigned size;
+} RadixTree;
+
+/**
+ * constructs a new radix tree.
+ * @param freeFunc: a function to free an item (may be NULL if the tree does not own its items).
+ * @return: pointer to the new tree, NULL on failure.
+ */
+RadixTree *newRadixTree(FreeFunc freeFunc);
+
+/**
+ * add an item to the tree
+ * @param tree: the tree to add an item to.
+ * @param data: item to add to the tree, a string.
+ * @return: 0 on failure, other on success. (if the item is already in the tree - failure).
+ */
+int insertToRadixTree(RadixTree *tree, void *data);
+
+/**
+ * remove an item from the tree
+ * @param tree: the tree to remove an item from.
+ * @param data: item to remove from the tree.
+ * @return: 0 on failure, other on success. (if data is not in the tree - failure).
+ */
+int deleteFromRadixTree(RadixTree *tree, void *data);
+
+/**
+ * check whether the tree contains this item.
+ * @param tree: the tree to search in.
+ * @param data: item to check.
+ * @return: 0 if the item is not in the tree, other if it is.
+ */
+int radixTreeContains(const RadixTree *tree, const void *data);
+
+/**
+ * Activate a function on each item of the tree. the order is the ascending order of stringCompare.
+ * if one of the activations of the function returns 0, the process stops.
+ * @param tree: the tree with all the items.
+ * @param func: the function to activate on all items.
+ * @param args: more optional arguments to the function (may be null if the given function support it).
+ * @return: 0 on failure, other on success.
+ */
+int forEachRadixTree(const RadixTree *tree, forEachFunc func, void *args);
+
+/**
+ * free all memory of the data structure.
+ * @param tree: pointer to the tree to free.
+ */
+void freeRadixTree(RadixTree **tree);
+
+#endif //RBTREE_RADIXTREE_H
@@ -0,0 +1,521 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <pthread.h>
+#include "ShardedRBTree.h"
+
+#define FAIL 0
+#define SUCCESS 1
+
+/**
+ * the shards, their locks and the boundaries between them.
+ */
+struct ShardedRBTree
+{
+	RBTree **shards;
+	pthread_rwlock_t *locks;
+	const void **boundaries;
+	int numShards;
+	CompareFunc compFunc;
+};
+
+/**
+ * the arguments of collectSample
+ */
+typedef struct SampleCollector
+{
+	const void **sorted;
+	long unsigned count;
+} SampleCollector;
+
+/**
+ * the work of one thread of parallelInsertBatch: the items of one shard.
+ */
+typedef struct ShardBatch
+{
+	ShardedRBTree *tree;
+	int shard;
+	void **items;
+	long unsigned *indices;
+	long unsigned count;
+	int *results;
+} ShardBatch;
+
+/**
+ * constructs a new sharded tree with the given boundaries.
+ * @param compFunc: a function to compare two items.
+ * @param freeFunc: a function to free an item.
+ * @param boundaries: the boundaries of the shards in an ascending order (the array is copied, the
+ * items are not, so they must stay valid as long as the tree is used).
+ * @param numBoundaries: the number of boundaries, the tree has numBoundaries + 1 shards.
+ * @return: pointer to the new tree, NULL on failure.
+ */
+ShardedRBTree *newShardedRBTree(CompareFunc compFunc, FreeFunc freeFunc, const void *const *boundaries,
+								int numBoundaries)
+{
+	if(compFunc == NULL || numBoundaries < 0 || (numBoundaries > 0 && boundaries == NULL))
+	{
+		return NULL;
+	}
+	ShardedRBTree* tree = (ShardedRBTree *) malloc(sizeof(ShardedRBTree));
+	if(tree == NULL)
+	{
+		return NULL;
+	}
+	tree->numShards = 0;
+	tree->compFunc = compFunc;
+	tree->shards = (RBTree **) malloc(sizeof(RBTree *) * (numBoundaries + 1));
+	tree->locks = (pthread_rwlock_t *) malloc(sizeof(pthread_rwlock_t) * (numBoundaries + 1));
+	tree->boundaries = (const void **) malloc(sizeof(void *) * (numBoundaries + 1));
+	if(tree->shards == NULL || tree->locks == NULL || tree->boundaries == NULL)
+	{
+		freeShardedRBTree(&tree);
+		return NULL;
+	}
+	for(int i = 0; i < numBoundaries; i++)
+	{
+		tree->boundaries[i] = boundaries[i];
+	}
+	for(int i = 0; i <= numBoundaries; i++)
+	{
+		tree->shards[i] = newRBTree(compFunc, freeFunc);
+		if(tree->shards[i] == NULL)
+		{
+			freeShardedRBTree(&tree);
+			return NULL;
+		}
+		if(pthread_rwlock_init(&tree->locks[i], NULL) != 0)
+		{
+			freeRBTree(&tree->shards[i]);
+			freeShardedRBTree(&tree);
+			return NULL;
+		}
+		tree->numShards++;
+	}
+	return tree;
+}
+
+/**
+ * ForEach function that appends an item of the sample to the sorted array
+ * @param object the item
+ * @param args pointer to the collector
+ * @return 1
+ */
+int collectSample(const void *object, void *args)
+{
+	SampleCollector* collector = (SampleCollector *) args;
+	collector->sorted[collector->count] = object;
+	collector->count++;
+	return SUCCESS;
+}
+
+/**
+ * constructs a new sharded tree whose boundaries split a sample of the items to equal parts.
+ * @param compFunc: a function to compare two items.
+ * @param freeFunc: a function to free an item.
+ * @param sample: items which represent the expected distribution (in any order). the boundaries
+ * are taken from them, so the sampled items must stay valid as long as the tree is used.
+ * @param sampleSize: the number of items in the sample.
+ * @param numShards: the wanted number of shards (less are made if the sample is too small).
+ * @return: pointer to the new tree, NULL on failure.
+ */
+ShardedRBTree *newShardedRBTreeFromSample(CompareFunc compFunc, FreeFunc freeFunc, const void *const *sample,
+										  long unsigned sampleSize, int numShards)
+{
+	if(compFunc == NULL || numShards < 1 || (sampleSize > 0 && sample == NULL))
+	{
+		return NULL;
+	}
+	// sorting by a tree which does not own the items also drops the duplicates of the sample.
+	RBTree* sorter = newRBTree(compFunc, NULL);
+	SampleCollector collector;
+	collector.sorted = (const void **) malloc(sizeof(void *) * (sampleSize + 1));
+	collector.count = 0;
+	if(sorter == NULL || collector.sorted == NULL)
+	{
+		freeRBTree(&sorter);
+		free(collector.sorted);
+		return NULL;
+	}
+	for(long unsigned i = 0; i < sampleSize; i++)
+	{
+		insertToRBTree(sorter, (void *) sample[i]);
+	}
+	forEachRBTree(sorter, collectSample, &collector);
+	freeRBTree(&sorter);
+	if(collector.count < (long unsigned) numShards)
+	{
+		numShards = collector.count > 0 ? (int) collector.count : 1;
+	}
+	for(int i = 0; i < numShards - 1; i++)
+	{
+		collector.sorted[i] = collector.sorted[(i + 1) * collector.count / numShards];
+	}
+	ShardedRBTree* tree = newShardedRBTree(compFunc, freeFunc, collector.sorted, numShards - 1);
+	free(collector.sorted);
+	return tree;
+}
+
+/**
+ * finds the shard of an item by a binary search on the boundaries
+ * @param tree the tree
+ * @param data the item
+ * @return the index of the shard
+ */
+int findShard(const ShardedRBTree *tree, const void *data)
+{
+	int low = 0;
+	int high = tree->numShards - 1;
+	while(low < high)
+	{
+		int middle = low + (high - low) / 2;
+		if(tree->compFunc(data, tree->boundaries[middle]) < 0)
+		{
+			high = middle;
+		}
+		else
+		{
+			low = middle + 1;
+		}
+	}
+	return low;
+}
+
+/**
+ * add an item to the tree. may be called from several threads at once.
+ * @param tree: the tree to add an item to.
+ * @param data: item to add to the tree.
+ * @return: 0 on failure, other on success. (if the item is already in the tree - failure).
+ */
+int insertToShardedRBTree(ShardedRBTree *tree, void *data)
+{
+	if(tree == NULL || data == NULL)
+	{
+		return FAIL;
+	}
+	int shard = findShard(tree, data);
+	pthread_rwlock_wrlock(&tree->locks[shard]);
+	int res = insertToRBTree(tree->shards[shard], data);
+	pthread_rwlock_unlock(&tree->locks[shard]);
+	return res;
+}
+
+/**
+ * remove an item from the tree. may be called from several threads at once.
+ * @param tree: the tree to remove an item from.
+ * @param data: item to remove from the tree.
+ * @return: 0 on failure, other on success. (if data is not in the tree - failure).
+ */
+int deleteFromShardedRBTree(ShardedRBTree *tree, void *data)
+{
+	if(tree == NULL || data == NULL)
+	{
+		return FAIL;
+	}
+	int shard = findShard(tree, data);
+	pthread_rwlock_wrlock(&tree->locks[shard]);
+	int res = deleteFromRBTree(tree->shards[shard], data);
+	pthread_rwlock_unlock(&tree->locks[shard]);
+	return res;
+}
+
+/**
+ * inserts the items of one shard under its write lock (thread function of parallelInsertBatch)
+ * @param args pointer to the ShardBatch
+ * @return NULL
+ */
+void *insertShardBatch(void *args)
+{
+	ShardBatch* batch = (ShardBatch *) args;
+	pthread_rwlock_wrlock(&batch->tree->locks[batch->shard]);
+	for(long unsigned i = 0; i < batch->count; i++)
+	{
+		long unsigned index = batch->indices[i];
+		int res = insertToRBTree(batch->tree->shards[batch->shard], batch->items[index]);
+		if(batch->results != NULL)
+		{
+			batch->results[index] = res;
+		}
+	}
+	pthread_rwlock_unlock(&batch->tree->locks[batch->shard]);
+	return NULL;
+}
+
+/**
+ * add many items to the tree: the items are split to their shards and every shard is filled by a
+ * thread of its own. may be called while other threads use the tree.
+ * @param tree: the tree to add the items to.
+ * @param items: the items to add.
+ * @param n: the number of items.
+ * @param results: may be NULL. else an array of n ints, results[i] is set to 0 if items[i] was not
+ * added (e.g. it was already in the tree, and then it still belongs to the caller), other if it was.
+ * NULL items are skipped (their results are 0), the other items are still added.
+ * @return: 0 on failure (no item was added), other on success.
+ */
+int parallelInsertBatch(ShardedRBTree *tree, void **items, long unsigned n, int *results)
+{
+	if(tree == NULL || (n > 0 && items == NULL))
+	{
+		return FAIL;
+	}
+	int* shardOf = (int *) malloc(sizeof(int) * (n + 1));
+	long unsigned* indices = (long unsigned *) malloc(sizeof(long unsigned) * (n + 1));
+	ShardBatch* batches = (ShardBatch *) calloc(tree->numShards, sizeof(ShardBatch));
+	pthread_t* threads = (pthread_t *) malloc(sizeof(pthread_t) * tree->numShards);
+	int* started = (int *) calloc(tree->numShards, sizeof(int));
+	if(shardOf == NULL || indices == NULL || batches == NULL || threads == NULL || started == NULL)
+	{
+		free(shardOf);
+		free(indices);
+		free(batches);
+		free(threads);
+		free(started);
+		return FAIL;
+	}
+	for(long unsigned i = 0; i < n; i++)
+	{
+		// a NULL item has no shard, it must not reach the CompareFunc.
+		if(items[i] == NULL)
+		{
+			shardOf[i] = -1;
+			if(results != NULL)
+			{
+				results[i] = 0;
+			}
+			continue;
+		}
+		shardOf[i] = findShard(tree, items[i]);
+		batches[shardOf[i]].count++;
+	}
+	long unsigned offset = 0;
+	for(int shard = 0; shard < tree->numShards; shard++)
+	{
+		batches[shard].tree = tree;
+		batches[shard].shard = shard;
+		batches[shard].items = items;
+		batches[shard].results = results;
+		batches[shard].indices = indices + offset;
+		offset += batches[shard].count;
+		batches[shard].count = 0;
+	}
+	for(long unsigned i = 0; i < n; i++)
+	{
+		if(shardOf[i] < 0)
+		{
+			continue;
+		}
+		ShardBatch* batch = &batches[shardOf[i]];
+		batch->indices[batch->count] = i;
+		batch->count++;
+	}
+	for(int shard = 0; shard < tree->numShards; shard++)
+	{
+		if(batches[shard].count > 0)
+		{
+			started[shard] = pthread_create(&threads[shard], NULL, insertShardBatch, &batches[shard]) == 0;
+			if(started[shard] == 0)
+			{
+				insertShardBatch(&batches[shard]);
+			}
+		}
+	}
+	for(int shard = 0; shard < tree->numShards; shard++)
+	{
+		if(started[shard])
+		{
+			pthread_join(threads[shard], NULL);
+		}
+	}
+	free(shardOf);
+	free(indices);
+	free(batches);
+	free(threads);
+	free(started);
+	return SUCCESS;
+}
+
+/**
+ * apply a batch of inserts and deletes atomically: the operations are split to their shards, the
+ * shards they touch are write locked together (in the order of the shards), and the batch of every
+ * shard is prepared before any of them is committed. so the whole batch is applied or nothing is,
+ * and no other thread sees a part of it. may be called while other threads use the tree.
+ * @param tree: the tree.
+ * @param ops: the operations (see RBTreeApplyBatch).
+ * @param n: the number of operations.
+ * @param results: may be NULL. else an array of n ints, set as by RBTreeApplyBatch.
+ * @return: 0 on failure (the tree is not changed), other on success.
+ */
+int applyBatchToShardedRBTree(ShardedRBTree *tree, const BatchOp *ops, long unsigned n, int *results)
+{
+	if(tree == NULL || (n > 0 && ops == NULL))
+	{
+		return FAIL;
+	}
+	int* shardOf = (int *) malloc(sizeof(int) * (n + 1));
+	long unsigned* indices = (long unsigned *) malloc(sizeof(long unsigned) * (n + 1));
+	BatchOp* shardOps = (BatchOp *) malloc(sizeof(BatchOp) * (n + 1));
+	int* shardResults = (int *) malloc(sizeof(int) * (n + 1));
+	long unsigned* offsets = (long unsigned *) calloc(tree->numShards + 1, sizeof(long unsigned));
+	PreparedBatch** prepared = (PreparedBatch **) calloc(tree->numShards, sizeof(PreparedBatch *));
+	if(shardOf == NULL || indices == NULL || shardOps == NULL || shardResults == NULL || offsets == NULL ||
+		prepared == NULL)
+	{
+		free(shardOf);
+		free(indices);
+		free(shardOps);
+		free(shardResults);
+		free(offsets);
+		free(prepared);
+		return FAIL;
+	}
+	for(long unsigned i = 0; i < n; i++)
+	{
+		shardOf[i] = ops[i].data == NULL ? 0 : findShard(tree, ops[i].data);
+		offsets[shardOf[i] + 1]++;
+	}
+	for(int shard = 0; shard < tree->numShards; shard++)
+	{
+		offsets[shard + 1] += offsets[shard];
+	}
+	for(long unsigned i = 0; i < n; i++)
+	{
+		long unsigned position = offsets[shardOf[i]];
+		shardOps[position] = ops[i];
+		indices[position] = i;
+		offsets[shardOf[i]]++;
+	}
+	// every offset moved to the end of its shard, which is the beginning of the next shard.
+	for(int shard = tree->numShards; shard > 0; shard--)
+	{
+		offsets[shard] = offsets[shard - 1];
+	}
+	offsets[0] = 0;
+	int res = SUCCESS;
+	for(int shard = 0; shard < tree->numShards; shard++)
+	{
+		if(offsets[shard + 1] > offsets[shard])
+		{
+			pthread_rwlock_wrlock(&tree->locks[shard]);
+			prepared[shard] = RBTreePrepareBatch(tree->shards[shard], shardOps + offsets[shard],
+												 offsets[shard + 1] - offsets[shard]);
+			if(prepared[shard] == NULL)
+			{
+				res = FAIL;
+			}
+		}
+	}
+	for(int shard = 0; shard < tree->numShards; shard++)
+	{
+		if(offsets[shard + 1] > offsets[shard])
+		{
+			if(res)
+			{
+				RBTreeCommitBatch(&prepared[shard], shardResults + offsets[shard]);
+			}
+			else
+			{
+				RBTreeAbortBatch(&prepared[shard]);
+			}
+			pthread_rwlock_unlock(&tree->locks[shard]);
+		}
+	}
+	for(long unsigned i = 0; i < n && res && results != NULL; i++)
+	{
+		results[indices[i]] = shardResults[i];
+	}
+	free(shardOf);
+	free(indices);
+	free(shardOps);
+	free(shardResults);
+	free(offsets);
+	free(prepared);
+	return res;
+}
+
+/**
+ * check whether the tree contains this item. may be called from several threads at once.
+ * @param tree: the tree to search in.
+ * @param data: item to check.
+ * @return: 0 if the item is not in the tree, other if it is.
+ */
+int shardedRBTreeContains(ShardedRBTree *tree, const void *data)
+{
+	if(tree == NULL || data == NULL)
+	{
+		return FAIL;
+	}
+	int shard = findShard(tree, data);
+	pthread_rwlock_rdlock(&tree->locks[shard]);
+	int res = RBTreeContains(tree->shards[shard], data);
+	pthread_rwlock_unlock(&tree->locks[shard]);
+	return res;
+}
+
+/**
+ * get the number of items in the tree.
+ * @param tree: the tree.
+ * @return: the number of items.
+ */
+long unsigned shardedRBTreeSize(ShardedRBTree *tree)
+{
+	if(tree == NULL)
+	{
+		return 0;
+	}
+	long unsigned size = 0;
+	for(int i = 0; i < tree->numShards; i++)
+	{
+		pthread_rwlock_rdlock(&tree->locks[i]);
+		size += tree->shards[i]->size;
+		pthread_rwlock_unlock(&tree->locks[i]);
+	}
+	return size;
+}
+
+/**
+ * Activate a function on each item of the tree in an ascending order, across all the shards. every
+ * shard is read locked while its items are visited. if one of the activations of the function
+ * returns 0, the process stops.
+ * @param tree: the tree with all the items.
+ * @param func: the function to activate on all items.
+ * @param args: more optional arguments to the function (may be null if the given function support it).
+ * @return: 0 on failure, other on success.
+ */
+int forEachShardedRBTree(ShardedRBTree *tree, forEachFunc func, void *args)
+{
+	if(tree == NULL || func == NULL)
+	{
+		return FAIL;
+	}
+	for(int i = 0; i < tree->numShards; i++)
+	{
+		pthread_rwlock_rdlock(&tree->locks[i]);
+		int res = forEachRBTree(tree->shards[i], func, args);
+		pthread_rwlock_unlock(&tree->locks[i]);
+		if(res == 0)
+		{
+			return FAIL;
+		}
+	}
+	return SUCCESS;
+}
+
+/**
+ * free all memory of the data structure. no other thread may use the tree at that time.
+ * @param tree: pointer to the tree to free.
+ */
+void freeShardedRBTree(ShardedRBTree **tree)
+{
+	if(*tree != NULL)
+	{
+		for(int i = 0; i < (*tree)->numShards; i++)
+		{
+			freeRBTree(&(*tree)->shards[i]);
+			pthread_rwlock_destroy(&(*tree)->locks[i]);
+		}
+		free((*tree)->shards);
+		free((*tree)->locks);
+		free((*tree)->boundaries);
+		free(*tree);
+	}
+	*tree = NULL;
+}
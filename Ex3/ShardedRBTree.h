@@ -0,0 +1,113 @@
+#ifndef RBTREE_SHARDEDRBTREE_H
+#define RBTREE_SHARDEDRBTREE_H
+
+#include "RBTree.h"
+
+/**
+ * a thread safe tree made of several RBTrees, each holding one range of the items and guarded by
+ * its own readers-writer lock, so writers working on different ranges do not block each other.
+ * the ranges are set by boundary items: shard i holds the items which are not lower than
+ * boundary i - 1 and lower than boundary i.
+ */
+typedef struct ShardedRBTree ShardedRBTree;
+
+/**
+ * constructs a new sharded tree with the given boundaries.
+ * @param compFunc: a function to compare two items.
+ * @param freeFunc: a function to free an item.
+ * @param boundaries: the boundaries of the shards in an ascending order (the array is copied, the
+ * items are not, so they must stay valid as long as the tree is used).
+ * @param numBoundaries: the number of boundaries, the tree has numBoundaries + 1 shards.
+ * @return: pointer to the new tree, NULL on failure.
+ */
+ShardedRBTree *newShardedRBTree(CompareFunc compFunc, FreeFunc freeFunc, const void *const *boundaries,
+								int numBoundaries);
+
+/**
+ * constructs a new sharded tree whose boundaries split a sample of the items to equal parts.
+ * @param compFunc: a function to compare two items.
+ * @param freeFunc: a function to free an item.
+ * @param sample: items which represent the expected distribution (in any order). the boundaries
+ * are taken from them, so the sampled items must stay valid as long as the tree is used.
+ * @param sampleSize: the number of items in the sample.
+ * @param numShards: the wanted number of shards (less are made if the sample is too small).
+ * @return: pointer to the new tree, NULL on failure.
+ */
+ShardedRBTree *newShardedRBTreeFromSample(CompareFunc compFunc, FreeFunc freeFunc, const void *const *sample,
+										  long unsigned sampleSize, int numShards);
+
+/**
+ * add an item to the tree. may be called from several threads at once.
+ * @param tree: the tree to add an item to.
+ * @param data: item to add to the tree.
+ * @return: 0 on failure, other on success. (if the item is already in the tree - failure).
+ */
+int insertToShardedRBTree(ShardedRBTree *tree, void *data);
+
+/**
+ * remove an item from the tree. may be called from several threads at once.
+ * @param tree: the tree to remove an item from.
+ * @param data: item to remove from the tree.
+ * @return: 0 on failure, other on success. (if data is not in the tree - failure).
+ */
+int deleteFromShardedRBTree(ShardedRBTree *tree, void *data);
+
+/**
+ * add many items to the tree: the items are split to their shards and every shard is filled by a
+ * thread of its own. may be called while other threads use the tree.
+ * @param tree: the tree to add the items to.
+ * @param items: the items to add.
+ * @param n: the number of items.
+ * @param results: may be NULL. else an array of n ints, results[i] is set to 0 if items[i] was not
+ * added (e.g. it was already in the tree, and then it still belongs to the caller), other if it was.
+ * NULL items are skipped (their results are 0), the other items are still added.
+ * @return: 0 on failure (no item was added), other on success.
+ */
+int parallelInsertBatch(ShardedRBTree *tree, void **items, long unsigned n, int *results);
+
+/**
+ * apply a batch of inserts and deletes atomically: the operations are split to their shards, the
+ * shards they touch are write locked together (in the order of the shards), and the batch of every
+ * shard is prepared before any of them is committed. so the whole batch is applied or nothing is,
+ * and no other thread sees a part of it. may be called while other threads use the tree.
+ * @param tree: the tree.
+ * @param ops: the operations (see RBTreeApplyBatch).
+ * @param n: the number of operations.
+ * @param results: may be NULL. else an array of n ints, set as by RBTreeApplyBatch.
+ * @return: 0 on failure (the tree is not changed), other on success.
+ */
+int applyBatchToShardedRBTree(ShardedRBTree *tree, const BatchOp *ops, long unsigned n, int *results);
+
+/**
+ * check whether the tree contains this item. may be called from several threads at once.
+ * @param tree: the tree to search in.
+ * @param data: item to check.
+ * @return: 0 if the item is not in the tree, other if it is.
+ */
+int shardedRBTreeContains(ShardedRBTree *tree, const void *data);
+
+/**
+ * get the number of items in the tree.
+ * @param tree: the tree.
+ * @return: the number of items.
+ */
+long unsigned shardedRBTreeSize(ShardedRBTree *tree);
+
+/**
+ * Activate a function on each item of the tree in an ascending order, across all the shards. every
+ * shard is read locked while its items are visited. if one of the activations of the function
+ * returns 0, the process stops.
+ * @param tree: the tree with all the items.
+ * @param func: the function to activate on all items.
+ * @param args: more optional arguments to the function (may be null if the given function support it).
+ * @return: 0 on failure, other on success.
+ */
+int forEachShardedRBTree(ShardedRBTree *tree, forEachFunc func, void *args);
+
+/**
+ * free all memory of the data structure. no other thread may use the tree at that time.
+ * @param tree: pointer to the tree to free.
+ */
+void freeShardedRBTree(ShardedRBTree **tree);
+
+#endif //RBTREE_SHARDEDRBTREE_H
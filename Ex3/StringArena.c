@@ -0,0 +1,315 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "StringArena.h"
+
+#define FAIL 0
+#define SUCCESS 1
+#define STRING_CHUNK_SIZE ((size_t) 64 * 1024)
+#define STRING_ALIGNMENT 16
+#define INTERN_MIN_CAPACITY 64
+#define FNV_OFFSET (14695981039346656037ULL)
+#define FNV_PRIME (1099511628211ULL)
+
+/**
+ * a chunk of the arena, allocated from its beginning up. allocations larger than a quarter of a
+ * chunk get a chunk of their own, which is linked after the current chunk so the current chunk
+ * keeps being filled.
+ */
+typedef struct StringChunk
+{
+	struct StringChunk *next;
+	size_t used;
+	size_t capacity;
+	char bytes[];
+} StringChunk;
+
+/**
+ * an entry of the table of the interned strings, empty entries have no string.
+ */
+typedef struct InternEntry
+{
+	unsigned long hash;
+	const char *string;
+} InternEntry;
+
+/**
+ * the arena: the chunks (the current one first) and an open addressing (linear probing) table of
+ * the interned strings, which is at most 3/4 full.
+ */
+struct StringArena
+{
+	StringChunk *chunks;
+	InternEntry *entries;
+	long unsigned mask;
+	long unsigned strings;
+	long unsigned interned;
+	size_t stringBytes;
+	size_t mappedBytes;
+};
+
+/**
+ * allocates a chunk and links it to the arena
+ * @param arena the arena
+ * @param capacity the number of bytes of the chunk
+ * @return pointer to the chunk, NULL on failure
+ */
+StringChunk *newStringChunk(StringArena *arena, size_t capacity)
+{
+	StringChunk* chunk = (StringChunk *) malloc(sizeof(StringChunk) + capacity);
+	if(chunk == NULL)
+	{
+		return NULL;
+	}
+	chunk->used = 0;
+	chunk->capacity = capacity;
+	if(arena->chunks != NULL && capacity > STRING_CHUNK_SIZE)
+	{
+		chunk->next = arena->chunks->next;
+		arena->chunks->next = chunk;
+	}
+	else
+	{
+		chunk->next = arena->chunks;
+		arena->chunks = chunk;
+	}
+	arena->mappedBytes += capacity;
+	return chunk;
+}
+
+/**
+ * allocates bytes from the current chunk of the arena, or from a new chunk if they do not fit
+ * @param arena the arena
+ * @param size the number of bytes
+ * @param alignment the alignment of the bytes, a power of 2
+ * @return pointer to the bytes, NULL on failure
+ */
+char *stringArenaBump(StringArena *arena, size_t size, size_t alignment)
+{
+	StringChunk* chunk = arena->chunks;
+	if(chunk != NULL)
+	{
+		uintptr_t start = (uintptr_t) (chunk->bytes + chunk->used);
+		size_t padding = (size_t) ((alignment - start % alignment) % alignment);
+		if(chunk->used + padding + size <= chunk->capacity)
+		{
+			chunk->used += padding + size;
+			return (char *) start + padding;
+		}
+	}
+	size_t capacity = STRING_CHUNK_SIZE;
+	if(size > STRING_CHUNK_SIZE / 4)
+	{
+		capacity = size + alignment;
+	}
+	chunk = newStringChunk(arena, capacity);
+	if(chunk == NULL)
+	{
+		return NULL;
+	}
+	uintptr_t start = (uintptr_t) chunk->bytes;
+	size_t padding = (size_t) ((alignment - start % alignment) % alignment);
+	chunk->used = padding + size;
+	return (char *) start + padding;
+}
+
+/**
+ * hashes a string (FNV-1a) and measures it in the same pass
+ * @param string the string
+ * @param length where to write the length of the string
+ * @return the hash
+ */
+unsigned long hashInterned(const char *string, size_t *length)
+{
+	unsigned long long hash = FNV_OFFSET;
+	const unsigned char* runner = (const unsigned char *) string;
+	while(*runner != '\0')
+	{
+		hash ^= *runner;
+		hash *= FNV_PRIME;
+		runner++;
+	}
+	*length = (size_t) (runner - (const unsigned char *) string);
+	return (unsigned long) hash;
+}
+
+/**
+ * moves the interned strings to a new table
+ * @param arena the arena
+ * @param capacity the number of entries of the new table, a power of 2
+ * @return 0 on failure (the table is not changed), 1 on success
+ */
+int resizeInternTable(StringArena *arena, long unsigned capacity)
+{
+	InternEntry* entries = (InternEntry *) calloc(capacity, sizeof(InternEntry));
+	if(entries == NULL)
+	{
+		return FAIL;
+	}
+	if(arena->entries != NULL)
+	{
+		for(long unsigned i = 0; i <= arena->mask; i++)
+		{
+			if(arena->entries[i].string != NULL)
+			{
+				long unsigned j = arena->entries[i].hash & (capacity - 1);
+				while(entries[j].string != NULL)
+				{
+					j = (j + 1) & (capacity - 1);
+				}
+				entries[j] = arena->entries[i];
+			}
+		}
+		free(arena->entries);
+	}
+	arena->entries = entries;
+	arena->mask = capacity - 1;
+	return SUCCESS;
+}
+
+/**
+ * constructs a new empty arena.
+ * @return: pointer to the new arena, NULL on failure.
+ */
+StringArena *newStringArena(void)
+{
+	StringArena* arena = (StringArena *) malloc(sizeof(StringArena));
+	if(arena == NULL)
+	{
+		return NULL;
+	}
+	arena->chunks = NULL;
+	arena->entries = NULL;
+	arena->mask = 0;
+	arena->strings = 0;
+	arena->interned = 0;
+	arena->stringBytes = 0;
+	arena->mappedBytes = 0;
+	if(resizeInternTable(arena, INTERN_MIN_CAPACITY) == 0)
+	{
+		free(arena);
+		return NULL;
+	}
+	return arena;
+}
+
+/**
+ * get the copy of a string in the arena, copying the string into the arena if it is not there yet.
+ * @param arena: the arena.
+ * @param string: the string to intern, it is not kept by the arena.
+ * @return: the copy of the string in the arena, it must not be changed or freed. NULL on failure.
+ */
+char *internString(StringArena *arena, const char *string)
+{
+	if(arena == NULL || string == NULL)
+	{
+		return NULL;
+	}
+	size_t length = 0;
+	unsigned long hash = hashInterned(string, &length);
+	long unsigned i = hash & arena->mask;
+	while(arena->entries[i].string != NULL)
+	{
+		if(arena->entries[i].hash == hash && memcmp(arena->entries[i].string, string, length + 1) == 0)
+		{
+			arena->interned++;
+			return (char *) arena->entries[i].string;
+		}
+		i = (i + 1) & arena->mask;
+	}
+	if((arena->strings + 1) * 4 > (arena->mask + 1) * 3)
+	{
+		if(resizeInternTable(arena, (arena->mask + 1) * 2) == 0)
+		{
+			return NULL;
+		}
+		i = hash & arena->mask;
+		while(arena->entries[i].string != NULL)
+		{
+			i = (i + 1) & arena->mask;
+		}
+	}
+	char* copy = stringArenaBump(arena, length + 1, 1);
+	if(copy == NULL)
+	{
+		return NULL;
+	}
+	memcpy(copy, string, length + 1);
+	arena->entries[i].hash = hash;
+	arena->entries[i].string = copy;
+	arena->strings++;
+	arena->interned++;
+	arena->stringBytes += length + 1;
+	return copy;
+}
+
+/**
+ * allocates memory from the arena (RBAllocator alloc function). the memory is released only when
+ * the arena is freed.
+ * @param size: the size to allocate.
+ * @param arena: pointer to the arena.
+ * @return: pointer to the allocated memory (aligned to 16 bytes), NULL on failure.
+ */
+void *stringArenaAlloc(size_t size, void *arena)
+{
+	if(arena == NULL)
+	{
+		return NULL;
+	}
+	return stringArenaBump((StringArena *) arena, size, STRING_ALIGNMENT);
+}
+
+/**
+ * fills an RBAllocator which allocates from the arena and never frees, to pass to
+ * newRBTreeWithAllocator with a NULL freeFunc for a tree of interned strings.
+ * @param arena: the arena.
+ * @param allocator: the allocator to fill.
+ */
+void StringArenaAllocator(StringArena *arena, RBAllocator *allocator)
+{
+	allocator->alloc = stringArenaAlloc;
+	allocator->free = NULL;
+	allocator->context = arena;
+}
+
+/**
+ * get the usage of the arena, e.g. to see how much deduplication saved.
+ * @param arena: the arena.
+ * @param stats: where to write the usage.
+ * @return: 0 on failure, other on success.
+ */
+int getStringArenaStats(const StringArena *arena, StringArenaStats *stats)
+{
+	if(arena == NULL || stats == NULL)
+	{
+		return FAIL;
+	}
+	stats->strings = arena->strings;
+	stats->interned = arena->interned;
+	stats->stringBytes = arena->stringBytes;
+	stats->mappedBytes = arena->mappedBytes;
+	return SUCCESS;
+}
+
+/**
+ * release all the memory of the arena at once. trees whose nodes were allocated from the arena
+ * must be freed before it (freeRBTree of such a tree is O(1)), and trees which hold its strings must
+ * not be searched after it.
+ * @param arena: pointer to the arena to free.
+ */
+void freeStringArena(StringArena **arena)
+{
+	if(*arena != NULL)
+	{
+		StringChunk* chunk = (*arena)->chunks;
+		while(chunk != NULL)
+		{
+			StringChunk* next = chunk->next;
+			free(chunk);
+			chunk = next;
+		}
+		free((*arena)->entries);
+		free(*arena);
+	}
+	*arena = NULL;
+}
@@ -0,0 +1,75 @@
+#ifndef RBTREE_STRINGARENA_H
+#define RBTREE_STRINGARENA_H
+
+#include "RBTree.h"
+
+/**
+ * an arena of interned strings. the bytes of the strings are bump allocated in large chunks, and a
+ * hash table of the strings in the arena makes every string stored once: interning a string which
+ * is already in the arena returns the stored copy. the stored strings stay at the same address
+ * until the arena is freed, so trees can hold them as items (with no FreeFunc), and a whole tree of
+ * interned strings is released with the arena instead of string by string.
+ * the arena can allocate the nodes of the trees too (StringArenaAllocator), then freeRBTree of such
+ * a tree is O(1). an arena is not thread safe.
+ */
+typedef struct StringArena StringArena;
+
+/**
+ * the usage of an arena.
+ */
+typedef struct StringArenaStats
+{
+	long unsigned strings; // the number of different strings in the arena.
+	long unsigned interned; // the number of calls to internString which returned a string.
+	size_t stringBytes; // the bytes of the different strings (with their '\0').
+	size_t mappedBytes; // the memory of the chunks of the arena.
+} StringArenaStats;
+
+/**
+ * constructs a new empty arena.
+ * @return: pointer to the new arena, NULL on failure.
+ */
+StringArena *newStringArena(void);
+
+/**
+ * get the copy of a string in the arena, copying the string into the arena if it is not there yet.
+ * @param arena: the arena.
+ * @param string: the string to intern, it is not kept by the arena.
+ * @return: the copy of the string in the arena, it must not be changed or freed. NULL on failure.
+ */
+char *internString(StringArena *arena, const char *string);
+
+/**
+ * allocates memory from the arena (RBAllocator alloc function). the memory is released only when
+ * the arena is freed.
+ * @param size: the size to allocate.
+ * @param arena: pointer to the arena.
+ * @return: pointer to the allocated memory (aligned to 16 bytes), NULL on failure.
+ */
+void *stringArenaAlloc(size_t size, void *arena);
+
+/**
+ * fills an RBAllocator which allocates from the arena and never frees, to pass to
+ * newRBTreeWithAllocator with a NULL freeFunc for a tree of interned strings.
+ * @param arena: the arena.
+ * @param allocator: the allocator to fill.
+ */
+void StringArenaAllocator(StringArena *arena, RBAllocator *allocator);
+
+/**
+ * get the usage of the arena, e.g. to see how much deduplication saved.
+ * @param arena: the arena.
+ * @param stats: where to write the usage.
+ * @return: 0 on failure, other on success.
+ */
+int getStringArenaStats(const StringArena *arena, StringArenaStats *stats);
+
+/**
+ * release all the memory of the arena at once. trees whose nodes were allocated from the arena
+ * must be freed before it (freeRBTree of such a tree is O(1)), and trees which hold its strings must
+ * not be searched after it.
+ * @param arena: pointer to the arena to free.
+ */
+void freeStringArena(StringArena **arena);
+
+#endif //RBTREE_STRINGARENA_H
@@ -1,5 +1,6 @@
 #include <string.h>
 #include <stdlib.h>
+#include <pthread.h>
 #include "Structs.h"
 
 #define EQUAL (0)
@@ -7,6 +8,50 @@
 #define GREATER (1)
 #define FAIL (0)
 #define SUCCESS (1)
+#define FNV_OFFSET (14695981039346656037ULL)
+#define FNV_PRIME (1099511628211ULL)
+#define MAX_NORM_THREADS (16)
+#define PARALLEL_NORM_MIN (4096) // Vectors below which the norms are computed on one thread.
+
+/**
+ * a Vector kept by the top k query: its norm and its position in the order of the tree
+ */
+typedef struct NormEntry
+{
+	double norm;
+	long unsigned position;
+} NormEntry;
+
+/**
+ * the k largest norms seen so far, in a min heap (the smallest of them at the root)
+ */
+typedef struct NormHeap
+{
+	NormEntry *entries;
+	int size;
+	int capacity;
+} NormHeap;
+
+/**
+ * the Vectors of the tree in its order, collected for the top k query
+ */
+typedef struct NormCollector
+{
+	const Vector **vectors;
+	long unsigned count;
+} NormCollector;
+
+/**
+ * the part of the top k query done by one thread: the Vectors [begin, end) and the heap of their
+ * k largest norms
+ */
+typedef struct NormJob
+{
+	const Vector **vectors;
+	long unsigned begin;
+	long unsigned end;
+	NormHeap heap;
+} NormJob;
 
 /**
  * CompFunc for strings (assumes strings end with "\0")
@@ -23,6 +68,24 @@ int stringCompare(const void *a, const void *b)
 	return compareVal;
 }
 
+/**
+ * HashFunc for strings (FNV-1a), can be used for the side indices of string trees.
+ * @param s - char* pointer
+ * @return the hash of the string
+ */
+unsigned long hashString(const void *s)
+{
+	const unsigned char* word = (const unsigned char *) s;
+	unsigned long long hash = FNV_OFFSET;
+	while(*word != '\0')
+	{
+		hash ^= *word;
+		hash *= FNV_PRIME;
+		word++;
+	}
+	return (unsigned long) hash;
+}
+
 /**
  * ForEach function that concatenates the given word and \n to pConcatenated. pConcatenated is
  * already allocated with enough space.
@@ -113,7 +176,7 @@ void freeVector(void *pVector)
  * @param vector the current vector
  * @return the norm of the vector
  */
-double normCalc(Vector* vector)
+double normCalc(const Vector* vector)
 {
 	double sum = 0;
 	for(int i = 0; i < vector->len; i++)
@@ -178,3 +241,235 @@ Vector *findMaxNormVectorInTree(RBTree *tree)
 	}
 	return maxNorm;
 }
+
+/**
+ * checks if an entry ranks below another: a smaller norm, or an equal norm later in the tree
+ * @param first the first entry
+ * @param second the second entry
+ * @return 1 if first ranks below second, else 0
+ */
+int normRanksBelow(const NormEntry *first, const NormEntry *second)
+{
+	if(first->norm != second->norm)
+	{
+		return first->norm < second->norm;
+	}
+	return first->position > second->position;
+}
+
+/**
+ * moves the entries on the path from the root of the heap up, until the place of an entry which
+ * replaces the root
+ * @param heap the heap
+ * @param entry the entry which replaces the root
+ * @return the place of the entry
+ */
+int siftNormDown(NormHeap *heap, const NormEntry *entry)
+{
+	NormEntry* entries = heap->entries;
+	int i = 0;
+	while(2 * i + 1 < heap->size)
+	{
+		int child = 2 * i + 1;
+		if(child + 1 < heap->size && normRanksBelow(&entries[child + 1], &entries[child]))
+		{
+			child++;
+		}
+		if(normRanksBelow(entry, &entries[child]))
+		{
+			break;
+		}
+		entries[i] = entries[child];
+		i = child;
+	}
+	return i;
+}
+
+/**
+ * offers an entry to the heap of the k largest norms
+ * @param heap the heap
+ * @param entry the entry
+ */
+void offerNorm(NormHeap *heap, NormEntry entry)
+{
+	NormEntry* entries = heap->entries;
+	int i = 0;
+	if(heap->size < heap->capacity)
+	{
+		i = heap->size;
+		heap->size++;
+		while(i > 0 && normRanksBelow(&entry, &entries[(i - 1) / 2]))
+		{
+			entries[i] = entries[(i - 1) / 2];
+			i = (i - 1) / 2;
+		}
+	}
+	else if(normRanksBelow(&entries[0], &entry))
+	{
+		i = siftNormDown(heap, &entry);
+	}
+	else
+	{
+		return;
+	}
+	entries[i] = entry;
+}
+
+/**
+ * adds a Vector of the tree to the collector (forEachFunc)
+ * @param object the Vector
+ * @param args the NormCollector
+ * @return 0 if the Vector is empty, else 1
+ */
+int collectNormVector(const void *object, void *args)
+{
+	const Vector* vector = (const Vector *) object;
+	NormCollector* collector = (NormCollector *) args;
+	if(vector == NULL || vector->vector == NULL || vector->len == 0)
+	{
+		return FAIL;
+	}
+	collector->vectors[collector->count] = vector;
+	collector->count++;
+	return SUCCESS;
+}
+
+/**
+ * computes the norms of the Vectors of one job and keeps the k largest (thread function)
+ * @param args pointer to the NormJob
+ * @return NULL
+ */
+void *runNormJob(void *args)
+{
+	NormJob* job = (NormJob *) args;
+	for(long unsigned i = job->begin; i < job->end; i++)
+	{
+		NormEntry entry = {normCalc(job->vectors[i]), i};
+		offerNorm(&job->heap, entry);
+	}
+	return NULL;
+}
+
+/**
+ * copies the Vectors of the heap to out, emptying the heap. the smallest norm is removed first, so
+ * out is filled from its end.
+ * @param vectors the Vectors of the tree
+ * @param heap the heap
+ * @param out the array of the copies
+ * @return 0 on failure (the copies made are freed), 1 on success
+ */
+int copyTopKNorms(const Vector **vectors, NormHeap *heap, Vector **out)
+{
+	int count = heap->size;
+	while(heap->size > 0)
+	{
+		NormEntry smallest = heap->entries[0];
+		heap->size--;
+		NormEntry last = heap->entries[heap->size];
+		heap->entries[siftNormDown(heap, &last)] = last;
+		const Vector* vector = vectors[smallest.position];
+		size_t vecSize = sizeof(double) * vector->len;
+		Vector* copy = (Vector *) malloc(sizeof(Vector));
+		double* coordinates = (double *) malloc(vecSize);
+		if(copy == NULL || coordinates == NULL)
+		{
+			free(copy);
+			free(coordinates);
+			for(int i = heap->size + 1; i < count; i++)
+			{
+				freeVector(out[i]);
+				out[i] = NULL;
+			}
+			return FAIL;
+		}
+		memcpy(coordinates, vector->vector, vecSize);
+		copy->len = vector->len;
+		copy->vector = coordinates;
+		out[heap->size] = copy;
+	}
+	return SUCCESS;
+}
+
+/**
+ * find the k Vectors of the tree with the largest norms (L2 Norm). the norm of every Vector is
+ * computed once, the k largest are kept in a bounded heap of norms and positions, and only they
+ * are copied at the end.
+ * @param tree a pointer to a tree of Vectors
+ * @param k the number of Vectors to find
+ * @param out an array of k pointers, filled with *copies* of the Vectors, the largest norm first
+ * (Vectors with equal norms are kept in the order of the tree). free them with freeVector.
+ * @return the number of Vectors found (k, or all the Vectors if there are fewer), 0 on failure.
+ */
+int findTopKNormVectors(const RBTree *tree, int k, Vector **out)
+{
+	return findTopKNormVectorsParallel(tree, k, out, 1);
+}
+
+/**
+ * findTopKNormVectors with the norms computed by several threads, each keeping the k largest of
+ * its part of the tree, which are merged at the end. the result is the same as findTopKNormVectors.
+ * @param tree a pointer to a tree of Vectors
+ * @param k the number of Vectors to find
+ * @param out an array of k pointers, filled with *copies* of the Vectors, the largest norm first
+ * @param numThreads the number of threads (1 to run on the calling thread)
+ * @return the number of Vectors found (k, or all the Vectors if there are fewer), 0 on failure.
+ */
+int findTopKNormVectorsParallel(const RBTree *tree, int k, Vector **out, unsigned numThreads)
+{
+	if(tree == NULL || k <= 0 || out == NULL || numThreads == 0 || tree->size == 0)
+	{
+		return FAIL;
+	}
+	if((long unsigned) k > tree->size)
+	{
+		k = (int) tree->size;
+	}
+	unsigned numJobs = numThreads > MAX_NORM_THREADS ? MAX_NORM_THREADS : numThreads;
+	if(tree->size < PARALLEL_NORM_MIN || tree->size < numJobs)
+	{
+		numJobs = 1;
+	}
+	const Vector** vectors = (const Vector **) malloc(sizeof(Vector *) * tree->size);
+	NormEntry* entries = (NormEntry *) malloc(sizeof(NormEntry) * k * numJobs);
+	NormCollector collector = {vectors, 0};
+	if(vectors == NULL || entries == NULL || forEachRBTree(tree, collectNormVector, &collector) == 0)
+	{
+		free(vectors);
+		free(entries);
+		return FAIL;
+	}
+	NormJob jobs[MAX_NORM_THREADS];
+	pthread_t threads[MAX_NORM_THREADS];
+	int started[MAX_NORM_THREADS];
+	for(unsigned i = 0; i < numJobs; i++)
+	{
+		NormJob job = {vectors, tree->size * i / numJobs, tree->size * (i + 1) / numJobs,
+					   {entries + (long unsigned) k * i, 0, k}};
+		jobs[i] = job;
+		started[i] = numJobs > 1 && pthread_create(&threads[i], NULL, runNormJob, &jobs[i]) == 0;
+		if(started[i] == 0)
+		{
+			runNormJob(&jobs[i]);
+		}
+	}
+	for(unsigned i = 0; i < numJobs; i++)
+	{
+		if(started[i])
+		{
+			pthread_join(threads[i], NULL);
+		}
+	}
+	// the heap of the first job absorbs the others, the norms are not computed again.
+	for(unsigned i = 1; i < numJobs; i++)
+	{
+		for(int j = 0; j < jobs[i].heap.size; j++)
+		{
+			offerNorm(&jobs[0].heap, jobs[i].heap.entries[j]);
+		}
+	}
+	int found = jobs[0].heap.size;
+	int res = copyTopKNorms(vectors, &jobs[0].heap, out);
+	free(vectors);
+	free(entries);
+	return res ? found : FAIL;
+}
@@ -26,6 +26,13 @@ typedef struct Vector
  */
 int stringCompare(const void *a, const void *b); // implement it in Structs.c
 
+/**
+ * HashFunc for strings (FNV-1a), can be used for the side indices of string trees.
+ * @param s - char* pointer
+ * @return the hash of the string
+ */
+unsigned long hashString(const void *s);
+
 /**
  * ForEach function that concatenates the given word and \n to pConcatenated. pConcatenated is
  * already allocated with enough space.
@@ -70,5 +77,28 @@ int copyIfNormIsLarger(const void *pVector, void *pMaxVector); // implement it i
  */
 Vector *findMaxNormVectorInTree(RBTree *tree); // implement it in Structs.c You must use copyIfNormIsLarger in the implementation!
 
+/**
+ * find the k Vectors of the tree with the largest norms (L2 Norm). the norm of every Vector is
+ * computed once, the k largest are kept in a bounded heap of norms and positions, and only they
+ * are copied at the end.
+ * @param tree a pointer to a tree of Vectors
+ * @param k the number of Vectors to find
+ * @param out an array of k pointers, filled with *copies* of the Vectors, the largest norm first
+ * (Vectors with equal norms are kept in the order of the tree). free them with freeVector.
+ * @return the number of Vectors found (k, or all the Vectors if there are fewer), 0 on failure.
+ */
+int findTopKNormVectors(const RBTree *tree, int k, Vector **out);
+
+/**
+ * findTopKNormVectors with the norms computed by several threads, each keeping the k largest of
+ * its part of the tree, which are merged at the end. the result is the same as findTopKNormVectors.
+ * @param tree a pointer to a tree of Vectors
+ * @param k the number of Vectors to find
+ * @param out an array of k pointers, filled with *copies* of the Vectors, the largest norm first
+ * @param numThreads the number of threads (1 to run on the calling thread)
+ * @return the number of Vectors found (k, or all the Vectors if there are fewer), 0 on failure.
+ */
+int findTopKNormVectorsParallel(const RBTree *tree, int k, Vector **out, unsigned numThreads);
+
 
 #endif //TA_EX3_STRUCTS_H
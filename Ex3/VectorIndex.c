@@ -0,0 +1,697 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "VectorIndex.h"
+
+#define FAIL 0
+#define SUCCESS 1
+#define VP_TREE_MAX_DIMENSION 12 // the crossover measured by bench_vector_index.
+#define VP_LEAF_SIZE 8
+#define MAX_SCAN_THREADS 16
+#define PARALLEL_SCAN_MIN ((long unsigned) 1 << 15) // coordinates below which a scan uses one thread.
+
+/**
+ * the index: the Vectors and a copy of their coordinates in the same order. in a VP tree the range
+ * [start, end) of a subtree (of more than VP_LEAF_SIZE vectors) holds its vantage point at start,
+ * then the inner half (the vectors whose distance from the vantage point is at most
+ * thresholds[start]), then the outer half (at least thresholds[start]).
+ */
+struct VectorIndex
+{
+	VectorIndexKind kind;
+	const Vector **vectors;
+	double *coordinates;
+	double *thresholds;
+	long unsigned count;
+	int dimension;
+	unsigned numThreads;
+};
+
+/**
+ * a candidate of a k-NN query.
+ */
+typedef struct Neighbour
+{
+	double distance;
+	long unsigned position;
+} Neighbour;
+
+/**
+ * the k nearest vectors seen so far, in a max heap by their distance.
+ */
+typedef struct NeighbourHeap
+{
+	Neighbour *entries;
+	int size;
+	int capacity;
+} NeighbourHeap;
+
+/**
+ * the arguments of collectVector
+ */
+typedef struct VectorCollector
+{
+	const Vector **vectors;
+	long unsigned count;
+	int dimension;
+} VectorCollector;
+
+/**
+ * the part of a scan done by one thread: the vectors [begin, end), and either a heap of their k
+ * nearest or a mark for every vector in the radius
+ */
+typedef struct ScanJob
+{
+	const VectorIndex *index;
+	const double *query;
+	long unsigned begin;
+	long unsigned end;
+	NeighbourHeap heap;
+	double radius;
+	unsigned char *inRadius;
+} ScanJob;
+
+/**
+ * the L2 distance between two points, summed in 4 independent lanes so the loop can be vectorized
+ * @param first the coordinates of the first point
+ * @param second the coordinates of the second point
+ * @param dimension the number of coordinates
+ * @return the distance
+ */
+double vectorDistance(const double *first, const double *second, int dimension)
+{
+	double sums[4] = {0, 0, 0, 0};
+	int i = 0;
+	for(; i + 4 <= dimension; i += 4)
+	{
+		for(int lane = 0; lane < 4; lane++)
+		{
+			double difference = first[i + lane] - second[i + lane];
+			sums[lane] += difference * difference;
+		}
+	}
+	for(; i < dimension; i++)
+	{
+		double difference = first[i] - second[i];
+		sums[0] += difference * difference;
+	}
+	return sqrt((sums[0] + sums[1]) + (sums[2] + sums[3]));
+}
+
+/**
+ * moves the entries on the path from the root of the heap up, until the place of an entry which
+ * replaces the root
+ * @param heap the heap
+ * @param distance the distance of the entry which replaces the root
+ * @return the place of the entry
+ */
+int siftNeighbourDown(NeighbourHeap *heap, double distance)
+{
+	Neighbour* entries = heap->entries;
+	int i = 0;
+	while(2 * i + 1 < heap->size)
+	{
+		int child = 2 * i + 1;
+		if(child + 1 < heap->size && entries[child + 1].distance > entries[child].distance)
+		{
+			child++;
+		}
+		if(entries[child].distance <= distance)
+		{
+			break;
+		}
+		entries[i] = entries[child];
+		i = child;
+	}
+	return i;
+}
+
+/**
+ * offers a vector to the heap of the k nearest
+ * @param heap the heap
+ * @param distance the distance of the vector from the query
+ * @param position the position of the vector in the index
+ */
+void offerNeighbour(NeighbourHeap *heap, double distance, long unsigned position)
+{
+	Neighbour* entries = heap->entries;
+	int i = 0;
+	if(heap->size < heap->capacity)
+	{
+		i = heap->size;
+		heap->size++;
+		while(i > 0 && entries[(i - 1) / 2].distance < distance)
+		{
+			entries[i] = entries[(i - 1) / 2];
+			i = (i - 1) / 2;
+		}
+	}
+	else if(distance < entries[0].distance)
+	{
+		i = siftNeighbourDown(heap, distance);
+	}
+	else
+	{
+		return;
+	}
+	entries[i].distance = distance;
+	entries[i].position = position;
+}
+
+/**
+ * removes the farthest of the k nearest from the heap
+ * @param heap the heap, not empty
+ * @return the removed entry
+ */
+Neighbour popFarthest(NeighbourHeap *heap)
+{
+	Neighbour farthest = heap->entries[0];
+	heap->size--;
+	Neighbour last = heap->entries[heap->size];
+	heap->entries[siftNeighbourDown(heap, last.distance)] = last;
+	return farthest;
+}
+
+/**
+ * the distance within which a vector can still enter the heap
+ * @param heap the heap
+ * @return the distance of the farthest of the k nearest, infinity until k vectors were seen
+ */
+double heapBound(const NeighbourHeap *heap)
+{
+	return heap->size < heap->capacity ? INFINITY : heap->entries[0].distance;
+}
+
+/**
+ * rearranges points so the nth smallest key is at nth, the smaller keys before it and the larger
+ * after it (quickselect)
+ * @param keys the keys (the distances from a vantage point)
+ * @param points the points, moved with their keys
+ * @param count the number of points
+ * @param nth the position to select
+ */
+void selectByDistance(double *keys, long unsigned *points, long count, long nth)
+{
+	long low = 0, high = count - 1;
+	while(low < high)
+	{
+		double pivot = keys[low + (high - low) / 2];
+		long i = low, j = high;
+		while(i <= j)
+		{
+			while(keys[i] < pivot)
+			{
+				i++;
+			}
+			while(keys[j] > pivot)
+			{
+				j--;
+			}
+			if(i <= j)
+			{
+				double key = keys[i];
+				keys[i] = keys[j];
+				keys[j] = key;
+				long unsigned point = points[i];
+				points[i] = points[j];
+				points[j] = point;
+				i++;
+				j--;
+			}
+		}
+		if(nth <= j)
+		{
+			high = j;
+		}
+		else if(nth >= i)
+		{
+			low = i;
+		}
+		else
+		{
+			return;
+		}
+	}
+}
+
+/**
+ * orders the vectors of a subtree of a VP tree: the first one is the vantage point, and the rest
+ * are split by the median of their distances from it into the inner and outer subtrees
+ * @param index the index, with the coordinates in their original order
+ * @param points the original positions of the vectors of the subtree, reordered
+ * @param keys room for the distances
+ * @param start the position of the subtree
+ * @param count the number of vectors of the subtree
+ */
+void buildVpTree(VectorIndex *index, long unsigned *points, double *keys, long unsigned start, long unsigned count)
+{
+	if(count <= VP_LEAF_SIZE)
+	{
+		return;
+	}
+	const double* vantage = index->coordinates + points[start] * index->dimension;
+	for(long unsigned i = start + 1; i < start + count; i++)
+	{
+		keys[i] = vectorDistance(vantage, index->coordinates + points[i] * index->dimension, index->dimension);
+	}
+	long unsigned innerCount = (count - 1) / 2;
+	selectByDistance(keys + start + 1, points + start + 1, (long) (count - 1), (long) innerCount);
+	index->thresholds[start] = keys[start + 1 + innerCount];
+	buildVpTree(index, points, keys, start + 1, innerCount);
+	buildVpTree(index, points, keys, start + 1 + innerCount, count - 1 - innerCount);
+}
+
+/**
+ * adds a Vector of the tree to the collector (forEachFunc)
+ * @param object the Vector
+ * @param args the VectorCollector
+ * @return 0 if the Vector has another length than the first one, else 1
+ */
+int collectVector(const void *object, void *args)
+{
+	const Vector* vector = (const Vector *) object;
+	VectorCollector* collector = (VectorCollector *) args;
+	if(vector->len <= 0 || vector->vector == NULL || (collector->count > 0 && vector->len != collector->dimension))
+	{
+		return FAIL;
+	}
+	collector->dimension = vector->len;
+	collector->vectors[collector->count] = vector;
+	collector->count++;
+	return SUCCESS;
+}
+
+/**
+ * frees the arrays of an index and the index
+ * @param index the index
+ */
+void freeVectorIndexArrays(VectorIndex *index)
+{
+	free(index->vectors);
+	free(index->coordinates);
+	free(index->thresholds);
+	free(index);
+}
+
+/**
+ * lays the vectors of an index out as a VP tree: the tree is built over their positions, and then
+ * the vectors and their coordinates are moved to the order of the tree
+ * @param index the index, with the vectors and coordinates in their original order
+ * @return 0 on failure, 1 on success
+ */
+int layOutVpTree(VectorIndex *index)
+{
+	long unsigned* points = (long unsigned *) malloc(sizeof(long unsigned) * (index->count + 1));
+	double* keys = (double *) malloc(sizeof(double) * (index->count + 1));
+	const Vector** vectors = (const Vector **) malloc(sizeof(Vector *) * (index->count + 1));
+	double* coordinates = (double *) malloc(sizeof(double) * index->dimension * index->count + 1);
+	index->thresholds = (double *) malloc(sizeof(double) * (index->count + 1));
+	if(points == NULL || keys == NULL || vectors == NULL || coordinates == NULL || index->thresholds == NULL)
+	{
+		free(points);
+		free(keys);
+		free(vectors);
+		free(coordinates);
+		return FAIL;
+	}
+	for(long unsigned i = 0; i < index->count; i++)
+	{
+		points[i] = i;
+	}
+	buildVpTree(index, points, keys, 0, index->count);
+	for(long unsigned i = 0; i < index->count; i++)
+	{
+		vectors[i] = index->vectors[points[i]];
+		memcpy(coordinates + i * index->dimension, index->coordinates + points[i] * index->dimension,
+			   sizeof(double) * index->dimension);
+	}
+	free(index->vectors);
+	free(index->coordinates);
+	index->vectors = vectors;
+	index->coordinates = coordinates;
+	free(points);
+	free(keys);
+	return SUCCESS;
+}
+
+/**
+ * builds an index of the Vectors of a tree.
+ * @param tree: a tree of Vectors which all have the same length.
+ * @param kind: the structure of the index, VECTOR_INDEX_AUTO to pick it by the dimension.
+ * @param numThreads: the number of threads of a scan (1 to scan on the calling thread).
+ * @return: pointer to the new index, NULL on failure.
+ */
+VectorIndex *newVectorIndex(const RBTree *tree, VectorIndexKind kind, unsigned numThreads)
+{
+	if(tree == NULL || numThreads == 0)
+	{
+		return NULL;
+	}
+	VectorIndex* index = (VectorIndex *) malloc(sizeof(VectorIndex));
+	if(index == NULL)
+	{
+		return NULL;
+	}
+	index->count = 0;
+	index->dimension = 0;
+	index->numThreads = numThreads > MAX_SCAN_THREADS ? MAX_SCAN_THREADS : numThreads;
+	index->thresholds = NULL;
+	index->coordinates = NULL;
+	index->vectors = (const Vector **) malloc(sizeof(Vector *) * (tree->size + 1));
+	if(index->vectors == NULL)
+	{
+		freeVectorIndexArrays(index);
+		return NULL;
+	}
+	VectorCollector collector = {index->vectors, 0, 0};
+	if(forEachRBTree(tree, collectVector, &collector) == 0 && tree->size > 0)
+	{
+		freeVectorIndexArrays(index);
+		return NULL;
+	}
+	index->count = collector.count;
+	index->dimension = collector.dimension;
+	index->coordinates = (double *) malloc(sizeof(double) * index->dimension * index->count + 1);
+	if(index->coordinates == NULL)
+	{
+		freeVectorIndexArrays(index);
+		return NULL;
+	}
+	for(long unsigned i = 0; i < index->count; i++)
+	{
+		memcpy(index->coordinates + i * index->dimension, index->vectors[i]->vector,
+			   sizeof(double) * index->dimension);
+	}
+	if(kind == VECTOR_INDEX_AUTO)
+	{
+		kind = index->dimension <= VP_TREE_MAX_DIMENSION ? VECTOR_INDEX_VP_TREE : VECTOR_INDEX_BRUTE_FORCE;
+	}
+	index->kind = kind;
+	if(kind == VECTOR_INDEX_VP_TREE && layOutVpTree(index) == 0)
+	{
+		freeVectorIndexArrays(index);
+		return NULL;
+	}
+	return index;
+}
+
+/**
+ * get the structure of the index (the one VECTOR_INDEX_AUTO picked).
+ * @param index: the index.
+ * @return: VECTOR_INDEX_VP_TREE or VECTOR_INDEX_BRUTE_FORCE, VECTOR_INDEX_AUTO on failure.
+ */
+VectorIndexKind getVectorIndexKind(const VectorIndex *index)
+{
+	if(index == NULL)
+	{
+		return VECTOR_INDEX_AUTO;
+	}
+	return index->kind;
+}
+
+/**
+ * the k-NN search of a subtree of a VP tree: the half the query falls in is searched first, and the
+ * other half only if the triangle inequality allows a vector in it to be nearer than the k found
+ * @param index the index
+ * @param query the coordinates of the query
+ * @param start the position of the subtree
+ * @param count the number of vectors of the subtree
+ * @param heap the k nearest found so far
+ */
+void nearestInVpTree(const VectorIndex *index, const double *query, long unsigned start, long unsigned count,
+					 NeighbourHeap *heap)
+{
+	if(count <= VP_LEAF_SIZE)
+	{
+		for(long unsigned i = start; i < start + count; i++)
+		{
+			offerNeighbour(heap, vectorDistance(query, index->coordinates + i * index->dimension, index->dimension), i);
+		}
+		return;
+	}
+	double distance = vectorDistance(query, index->coordinates + start * index->dimension, index->dimension);
+	offerNeighbour(heap, distance, start);
+	long unsigned innerCount = (count - 1) / 2;
+	double threshold = index->thresholds[start];
+	if(distance < threshold)
+	{
+		nearestInVpTree(index, query, start + 1, innerCount, heap);
+		if(distance + heapBound(heap) >= threshold)
+		{
+			nearestInVpTree(index, query, start + 1 + innerCount, count - 1 - innerCount, heap);
+		}
+	}
+	else
+	{
+		nearestInVpTree(index, query, start + 1 + innerCount, count - 1 - innerCount, heap);
+		if(distance - heapBound(heap) <= threshold)
+		{
+			nearestInVpTree(index, query, start + 1, innerCount, heap);
+		}
+	}
+}
+
+/**
+ * the radius search of a subtree of a VP tree
+ * @param index the index
+ * @param query the coordinates of the query
+ * @param radius the maximal distance
+ * @param start the position of the subtree
+ * @param count the number of vectors of the subtree
+ * @param func the function to activate on the vectors in the radius
+ * @param args more arguments to the function
+ * @return 0 if the function failed, else 1
+ */
+int radiusInVpTree(const VectorIndex *index, const double *query, double radius, long unsigned start,
+				   long unsigned count, forEachFunc func, void *args)
+{
+	if(count <= VP_LEAF_SIZE)
+	{
+		for(long unsigned i = start; i < start + count; i++)
+		{
+			if(vectorDistance(query, index->coordinates + i * index->dimension, index->dimension) <= radius &&
+				func(index->vectors[i], args) == 0)
+			{
+				return FAIL;
+			}
+		}
+		return SUCCESS;
+	}
+	double distance = vectorDistance(query, index->coordinates + start * index->dimension, index->dimension);
+	if(distance <= radius && func(index->vectors[start], args) == 0)
+	{
+		return FAIL;
+	}
+	long unsigned innerCount = (count - 1) / 2;
+	double threshold = index->thresholds[start];
+	if(distance - radius <= threshold && radiusInVpTree(index, query, radius, start + 1, innerCount, func, args) == 0)
+	{
+		return FAIL;
+	}
+	if(distance + radius >= threshold &&
+		radiusInVpTree(index, query, radius, start + 1 + innerCount, count - 1 - innerCount, func, args) == 0)
+	{
+		return FAIL;
+	}
+	return SUCCESS;
+}
+
+/**
+ * scans the vectors of one job (thread function)
+ * @param args pointer to the ScanJob
+ * @return NULL
+ */
+void *runScanJob(void *args)
+{
+	ScanJob* job = (ScanJob *) args;
+	const VectorIndex* index = job->index;
+	for(long unsigned i = job->begin; i < job->end; i++)
+	{
+		double distance = vectorDistance(job->query, index->coordinates + i * index->dimension, index->dimension);
+		if(job->inRadius != NULL)
+		{
+			job->inRadius[i] = distance <= job->radius;
+		}
+		else
+		{
+			offerNeighbour(&job->heap, distance, i);
+		}
+	}
+	return NULL;
+}
+
+/**
+ * splits a scan of all the vectors into jobs and runs them, each on a thread of its own (or on the
+ * calling thread if the scan is small or a thread cannot be created)
+ * @param index the index
+ * @param jobs the jobs, with their query and their heap or marks set
+ * @return the number of jobs
+ */
+unsigned runScan(const VectorIndex *index, ScanJob *jobs)
+{
+	unsigned numJobs = index->numThreads;
+	if(index->count * (long unsigned) index->dimension < PARALLEL_SCAN_MIN || index->count < numJobs)
+	{
+		numJobs = 1;
+	}
+	pthread_t threads[MAX_SCAN_THREADS];
+	int started[MAX_SCAN_THREADS];
+	for(unsigned i = 0; i < numJobs; i++)
+	{
+		jobs[i].begin = index->count * i / numJobs;
+		jobs[i].end = index->count * (i + 1) / numJobs;
+		started[i] = numJobs > 1 && pthread_create(&threads[i], NULL, runScanJob, &jobs[i]) == 0;
+		if(started[i] == 0)
+		{
+			runScanJob(&jobs[i]);
+		}
+	}
+	for(unsigned i = 0; i < numJobs; i++)
+	{
+		if(started[i])
+		{
+			pthread_join(threads[i], NULL);
+		}
+	}
+	return numJobs;
+}
+
+/**
+ * checks the arguments of a query
+ * @param index the index
+ * @param query the query
+ * @return 1 if the query can be run on the index, else 0
+ */
+int validVectorQuery(const VectorIndex *index, const Vector *query)
+{
+	return index != NULL && query != NULL && (index->count == 0 ||
+											  (query->vector != NULL && query->len == index->dimension));
+}
+
+/**
+ * find the k nearest Vectors to a query (k-NN).
+ * @param index: the index.
+ * @param query: the query, of the length of the indexed Vectors.
+ * @param k: the number of Vectors to find.
+ * @param neighbours: an array of k pointers, filled with the nearest Vectors, the nearest first.
+ * @param distances: may be NULL. else an array of k doubles, filled with the L2 distances of the
+ * Vectors.
+ * @return: the number of Vectors found (k, or all the Vectors if there are fewer), 0 on failure.
+ */
+int vectorIndexNearest(const VectorIndex *index, const Vector *query, int k, const Vector **neighbours,
+					   double *distances)
+{
+	if(validVectorQuery(index, query) == 0 || k <= 0 || neighbours == NULL || index->count == 0)
+	{
+		return 0;
+	}
+	if((long unsigned) k > index->count)
+	{
+		k = (int) index->count;
+	}
+	unsigned numHeaps = index->kind == VECTOR_INDEX_VP_TREE ? 1 : index->numThreads;
+	Neighbour* entries = (Neighbour *) malloc(sizeof(Neighbour) * k * numHeaps);
+	if(entries == NULL)
+	{
+		return 0;
+	}
+	NeighbourHeap heap = {entries, 0, k};
+	if(index->kind == VECTOR_INDEX_VP_TREE)
+	{
+		nearestInVpTree(index, query->vector, 0, index->count, &heap);
+	}
+	else
+	{
+		ScanJob jobs[MAX_SCAN_THREADS];
+		for(unsigned i = 0; i < numHeaps; i++)
+		{
+			ScanJob job = {index, query->vector, 0, 0, {entries + (long unsigned) k * i, 0, k}, 0, NULL};
+			jobs[i] = job;
+		}
+		unsigned numJobs = runScan(index, jobs);
+		heap = jobs[0].heap;
+		for(unsigned i = 1; i < numJobs; i++)
+		{
+			for(int j = 0; j < jobs[i].heap.size; j++)
+			{
+				offerNeighbour(&heap, jobs[i].heap.entries[j].distance, jobs[i].heap.entries[j].position);
+			}
+		}
+	}
+	// popping the farthest each time fills the results from the last one.
+	int found = heap.size;
+	while(heap.size > 0)
+	{
+		Neighbour farthest = popFarthest(&heap);
+		neighbours[heap.size] = index->vectors[farthest.position];
+		if(distances != NULL)
+		{
+			distances[heap.size] = farthest.distance;
+		}
+	}
+	free(entries);
+	return found;
+}
+
+/**
+ * Activate a function on every Vector whose L2 distance from a query is at most radius. the order
+ * is not defined. if one of the activations of the function returns 0, the process stops.
+ * @param index: the index.
+ * @param query: the query, of the length of the indexed Vectors.
+ * @param radius: the maximal distance.
+ * @param func: the function to activate on the Vectors (on the calling thread).
+ * @param args: more optional arguments to the function (may be null if the given function support it).
+ * @return: 0 on failure, other on success.
+ */
+int forEachVectorInRadius(const VectorIndex *index, const Vector *query, double radius, forEachFunc func,
+						  void *args)
+{
+	if(validVectorQuery(index, query) == 0 || func == NULL || !(radius >= 0))
+	{
+		return FAIL;
+	}
+	if(index->count == 0)
+	{
+		return SUCCESS;
+	}
+	if(index->kind == VECTOR_INDEX_VP_TREE)
+	{
+		return radiusInVpTree(index, query->vector, radius, 0, index->count, func, args);
+	}
+	unsigned char* inRadius = (unsigned char *) malloc(index->count);
+	if(inRadius == NULL)
+	{
+		return FAIL;
+	}
+	ScanJob jobs[MAX_SCAN_THREADS];
+	for(unsigned i = 0; i < index->numThreads; i++)
+	{
+		ScanJob job = {index, query->vector, 0, 0, {NULL, 0, 0}, radius, inRadius};
+		jobs[i] = job;
+	}
+	runScan(index, jobs);
+	int res = SUCCESS;
+	for(long unsigned i = 0; i < index->count && res; i++)
+	{
+		if(inRadius[i])
+		{
+			res = func(index->vectors[i], args);
+		}
+	}
+	free(inRadius);
+	return res != 0;
+}
+
+/**
+ * free all memory of the index (not the Vectors).
+ * @param index: pointer to the index to free.
+ */
+void freeVectorIndex(VectorIndex **index)
+{
+	if(*index != NULL)
+	{
+		freeVectorIndexArrays(*index);
+	}
+	*index = NULL;
+}
@@ -0,0 +1,76 @@
+#ifndef RBTREE_VECTORINDEX_H
+#define RBTREE_VECTORINDEX_H
+
+#include "RBTree.h"
+#include "Structs.h"
+
+/**
+ * the structure of a vector index.
+ */
+typedef enum VectorIndexKind
+{
+	VECTOR_INDEX_AUTO, VECTOR_INDEX_VP_TREE, VECTOR_INDEX_BRUTE_FORCE
+} VectorIndexKind;
+
+/**
+ * an index of the Vectors of a tree for similarity search by the L2 distance, which the order of
+ * vectorCompare1By1 cannot answer. the coordinates are copied to one array, in one of two layouts:
+ * a vantage point tree, where every node splits the vectors by their distance from one vector and
+ * the triangle inequality skips the parts which cannot hold an answer, or a flat array scanned by
+ * several threads. the tree prunes well in low dimensions and loses to the scan in high dimensions,
+ * where all the distances are alike, so VECTOR_INDEX_AUTO picks the tree up to
+ * VP_TREE_MAX_DIMENSION coordinates.
+ * the index holds pointers to the Vectors, it does not follow later changes of the tree and must
+ * be rebuilt after them. queries may run from several threads at once.
+ */
+typedef struct VectorIndex VectorIndex;
+
+/**
+ * builds an index of the Vectors of a tree.
+ * @param tree: a tree of Vectors which all have the same length.
+ * @param kind: the structure of the index, VECTOR_INDEX_AUTO to pick it by the dimension.
+ * @param numThreads: the number of threads of a scan (1 to scan on the calling thread).
+ * @return: pointer to the new index, NULL on failure.
+ */
+VectorIndex *newVectorIndex(const RBTree *tree, VectorIndexKind kind, unsigned numThreads);
+
+/**
+ * get the structure of the index (the one VECTOR_INDEX_AUTO picked).
+ * @param index: the index.
+ * @return: VECTOR_INDEX_VP_TREE or VECTOR_INDEX_BRUTE_FORCE, VECTOR_INDEX_AUTO on failure.
+ */
+VectorIndexKind getVectorIndexKind(const VectorIndex *index);
+
+/**
+ * find the k nearest Vectors to a query (k-NN).
+ * @param index: the index.
+ * @param query: the query, of the length of the indexed Vectors.
+ * @param k: the number of Vectors to find.
+ * @param neighbours: an array of k pointers, filled with the nearest Vectors, the nearest first.
+ * @param distances: may be NULL. else an array of k doubles, filled with the L2 distances of the
+ * Vectors.
+ * @return: the number of Vectors found (k, or all the Vectors if there are fewer), 0 on failure.
+ */
+int vectorIndexNearest(const VectorIndex *index, const Vector *query, int k, const Vector **neighbours,
+					   double *distances);
+
+/**
+ * Activate a function on every Vector whose L2 distance from a query is at most radius. the order
+ * is not defined. if one of the activations of the function returns 0, the process stops.
+ * @param index: the index.
+ * @param query: the query, of the length of the indexed Vectors.
+ * @param radius: the maximal distance.
+ * @param func: the function to activate on the Vectors (on the calling thread).
+ * @param args: more optional arguments to the function (may be null if the given function support it).
+ * @return: 0 on failure, other on success.
+ */
+int forEachVectorInRadius(const VectorIndex *index, const Vector *query, double radius, forEachFunc func,
+						  void *args);
+
+/**
+ * free all memory of the index (not the Vectors).
+ * @param index: pointer to the index to free.
+ */
+void freeVectorIndex(VectorIndex **index);
+
+#endif //RBTREE_VECTORINDEX_H
@@ -0,0 +1,230 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "RadixTree.h"
+#include "Structs.h"
+
+#define DEFAULT_KEYS 500000
+#define MAX_KEY_LENGTH 96
+#define NUM_KEY_SETS 3
+#define MILLION 1e6
+
+/**
+ * writes one key of a set to a buffer
+ * @param buffer the buffer, of MAX_KEY_LENGTH bytes
+ * @param i the index of the key
+ */
+typedef void (*KeyMaker)(char *buffer, long unsigned i);
+
+/**
+ * a URL: a few hosts, a few sections, and a long unique tail, so the keys share long prefixes
+ * @param buffer the buffer
+ * @param i the index of the key
+ */
+void makeUrl(char *buffer, long unsigned i)
+{
+	static const char *const hosts[] = {"www.example.com", "api.example.com", "shop.example.org", "blog.example.net"};
+	static const char *const sections[] = {"products", "users", "articles", "search", "static/images"};
+	snprintf(buffer, MAX_KEY_LENGTH, "https://%s/%s/%lu?session=%08x", hosts[rand() % 4], sections[rand() % 5], i,
+			 (unsigned) rand());
+}
+
+/**
+ * a word: 1 to 4 random syllables and the index, so the keys are short and share short prefixes
+ * @param buffer the buffer
+ * @param i the index of the key
+ */
+void makeWord(char *buffer, long unsigned i)
+{
+	static const char *const syllables[] = {"ka", "ro", "mi", "sen", "ta", "lo", "ver", "an", "is", "tu", "pre", "do"};
+	int length = 0;
+	int count = 1 + rand() % 4;
+	for(int s = 0; s < count; s++)
+	{
+		length += snprintf(buffer + length, (size_t) (MAX_KEY_LENGTH - length), "%s", syllables[rand() % 12]);
+	}
+	snprintf(buffer + length, (size_t) (MAX_KEY_LENGTH - length), "%lu", i);
+}
+
+/**
+ * a random UUID, so the keys share almost no prefixes
+ * @param buffer the buffer
+ * @param i the index of the key (unused, the keys are unique with high probability)
+ */
+void makeUuid(char *buffer, long unsigned i)
+{
+	(void) i;
+	snprintf(buffer, MAX_KEY_LENGTH, "%04x%04x-%04x-4%03x-%04x-%04x%04x%04x", (unsigned) rand() & 0xffff,
+			 (unsigned) rand() & 0xffff, (unsigned) rand() & 0xffff, (unsigned) rand() & 0xfff,
+			 ((unsigned) rand() & 0x3fff) | 0x8000, (unsigned) rand() & 0xffff, (unsigned) rand() & 0xffff,
+			 (unsigned) rand() & 0xffff);
+}
+
+/**
+ * the time since some fixed point
+ * @return the time in seconds
+ */
+double benchSeconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+}
+
+/**
+ * counts the items of a walk (forEachFunc)
+ * @param object an item
+ * @param args pointer to the counter
+ * @return 1
+ */
+int countItem(const void *object, void *args)
+{
+	(void) object;
+	(*(long unsigned *) args)++;
+	return 1;
+}
+
+/**
+ * makes n keys of a set
+ * @param maker the KeyMaker of the set
+ * @param n the number of keys
+ * @return the keys, NULL on failure
+ */
+char **makeKeys(KeyMaker maker, long unsigned n)
+{
+	char** keys = (char **) malloc(sizeof(char *) * n);
+	if(keys == NULL)
+	{
+		return NULL;
+	}
+	char buffer[MAX_KEY_LENGTH];
+	for(long unsigned i = 0; i < n; i++)
+	{
+		maker(buffer, i);
+		keys[i] = (char *) malloc(strlen(buffer) + 1);
+		if(keys[i] == NULL)
+		{
+			while(i > 0)
+			{
+				i--;
+				free(keys[i]);
+			}
+			free(keys);
+			return NULL;
+		}
+		strcpy(keys[i], buffer);
+	}
+	return keys;
+}
+
+/**
+ * shuffles the keys, so the inserts do not follow the order the keys were made in and the lookups
+ * do not follow the order of the inserts
+ * @param keys the keys
+ * @param n the number of keys
+ */
+void shuffleKeys(char **keys, long unsigned n)
+{
+	for(long unsigned i = n; i > 1; i--)
+	{
+		long unsigned j = (long unsigned) rand() % i;
+		char* temp = keys[i - 1];
+		keys[i - 1] = keys[j];
+		keys[j] = temp;
+	}
+}
+
+/**
+ * prints a line of the results
+ * @param set the name of the key set
+ * @param structure the name of the structure
+ * @param n the number of keys
+ * @param times the times of the insert, contains and walk phases
+ */
+void printResult(const char *set, const char *structure, long unsigned n, const double times[3])
+{
+	printf("%-6s %-8s %12.2f %12.2f %12.2f\n", set, structure, (double) n / times[0] / MILLION,
+		   (double) n / times[1] / MILLION, (double) n / times[2] / MILLION);
+}
+
+/**
+ * insert, contains and in order walk throughput of RadixTree against an RBTree with stringCompare,
+ * on URL, word and UUID key sets.
+ * usage: bench_radix [number of keys]
+ */
+int main(int argc, char *argv[])
+{
+	long unsigned n = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_KEYS;
+	const char* names[NUM_KEY_SETS] = {"url", "word", "uuid"};
+	KeyMaker makers[NUM_KEY_SETS] = {makeUrl, makeWord, makeUuid};
+	printf("%lu keys, Mops/s\n", n);
+	printf("%-6s %-8s %12s %12s %12s\n", "keys", "tree", "insert", "contains", "walk");
+	for(int set = 0; set < NUM_KEY_SETS; set++)
+	{
+		srand((unsigned) set + 1);
+		char** keys = makeKeys(makers[set], n);
+		if(keys == NULL)
+		{
+			fprintf(stderr, "out of memory\n");
+			return EXIT_FAILURE;
+		}
+		double times[3];
+		long unsigned walked = 0;
+
+		shuffleKeys(keys, n);
+		RBTree* tree = newRBTree(stringCompare, NULL);
+		double start = benchSeconds();
+		for(long unsigned i = 0; i < n; i++)
+		{
+			insertToRBTree(tree, keys[i]);
+		}
+		times[0] = benchSeconds() - start;
+		shuffleKeys(keys, n);
+		start = benchSeconds();
+		for(long unsigned i = 0; i < n; i++)
+		{
+			walked += (long unsigned) RBTreeContains(tree, keys[i]) != 0;
+		}
+		times[1] = benchSeconds() - start;
+		start = benchSeconds();
+		forEachRBTree(tree, countItem, &walked);
+		times[2] = benchSeconds() - start;
+		printResult(names[set], "rbtree", n, times);
+		freeRBTree(&tree);
+
+		shuffleKeys(keys, n);
+		RadixTree* radix = newRadixTree(NULL);
+		start = benchSeconds();
+		for(long unsigned i = 0; i < n; i++)
+		{
+			insertToRadixTree(radix, keys[i]);
+		}
+		times[0] = benchSeconds() - start;
+		shuffleKeys(keys, n);
+		start = benchSeconds();
+		for(long unsigned i = 0; i < n; i++)
+		{
+			walked += (long unsigned) radixTreeContains(radix, keys[i]) != 0;
+		}
+		times[1] = benchSeconds() - start;
+		start = benchSeconds();
+		forEachRadixTree(radix, countItem, &walked);
+		times[2] = benchSeconds() - start;
+		printResult(names[set], "radix", n, times);
+		freeRadixTree(&radix);
+
+		// the counter keeps the lookups and the walks from being optimized away.
+		if(walked != 4 * n)
+		{
+			fprintf(stderr, "the trees disagree on the %s keys\n", names[set]);
+		}
+		for(long unsigned i = 0; i < n; i++)
+		{
+			free(keys[i]);
+		}
+		free(keys);
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,202 @@
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "ShardedRBTree.h"
+
+#define DEFAULT_ITEMS 1000000
+#define MAX_WRITERS 32
+#define NUM_SHARDS 64
+#define MILLION 1e6
+
+/**
+ * the keys one writer thread inserts, and the tree it inserts them to: a ShardedRBTree, or an
+ * RBTree behind one global lock.
+ */
+typedef struct WriterJob
+{
+	ShardedRBTree *sharded;
+	RBTree *tree;
+	pthread_mutex_t *lock;
+	int **items;
+	long unsigned begin;
+	long unsigned end;
+} WriterJob;
+
+/**
+ * CompareFunc for ints
+ * @param a pointer to an int
+ * @param b pointer to an int
+ * @return the order of a and b
+ */
+int compareInts(const void *a, const void *b)
+{
+	int first = *(const int *) a, second = *(const int *) b;
+	return (first > second) - (first < second);
+}
+
+/**
+ * the time since some fixed point
+ * @return the time in seconds
+ */
+double benchSeconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+}
+
+/**
+ * makes the keys 0..n-1, shuffled inside the range of every writer, so every writer inserts its
+ * own keys in a random order
+ * @param n the number of keys
+ * @param writers the number of writers
+ * @return the keys, NULL on failure
+ */
+int **makeKeys(long unsigned n, unsigned writers)
+{
+	int** items = (int **) malloc(sizeof(int *) * n);
+	if(items == NULL)
+	{
+		return NULL;
+	}
+	for(long unsigned i = 0; i < n; i++)
+	{
+		items[i] = (int *) malloc(sizeof(int));
+		if(items[i] == NULL)
+		{
+			while(i > 0)
+			{
+				i--;
+				free(items[i]);
+			}
+			free(items);
+			return NULL;
+		}
+		*items[i] = (int) i;
+	}
+	for(unsigned w = 0; w < writers; w++)
+	{
+		long unsigned begin = n * w / writers, end = n * (w + 1) / writers;
+		for(long unsigned i = end; i > begin + 1; i--)
+		{
+			long unsigned j = begin + (long unsigned) rand() % (i - begin);
+			int* temp = items[i - 1];
+			items[i - 1] = items[j];
+			items[j] = temp;
+		}
+	}
+	return items;
+}
+
+/**
+ * inserts the keys of a job (thread function)
+ * @param args the WriterJob
+ * @return NULL
+ */
+void *runWriter(void *args)
+{
+	WriterJob* job = (WriterJob *) args;
+	for(long unsigned i = job->begin; i < job->end; i++)
+	{
+		if(job->sharded != NULL)
+		{
+			insertToShardedRBTree(job->sharded, job->items[i]);
+		}
+		else
+		{
+			pthread_mutex_lock(job->lock);
+			insertToRBTree(job->tree, job->items[i]);
+			pthread_mutex_unlock(job->lock);
+		}
+	}
+	return NULL;
+}
+
+/**
+ * times the insert of all the keys by several writers
+ * @param sharded the sharded tree, or NULL to insert to tree under lock
+ * @param tree the tree behind the global lock
+ * @param lock the global lock
+ * @param items the keys
+ * @param n the number of keys
+ * @param writers the number of writers
+ * @return the throughput in millions of inserts per second
+ */
+double timeWriters(ShardedRBTree *sharded, RBTree *tree, pthread_mutex_t *lock, int **items, long unsigned n,
+				   unsigned writers)
+{
+	pthread_t threads[MAX_WRITERS];
+	WriterJob jobs[MAX_WRITERS];
+	double start = benchSeconds();
+	for(unsigned w = 0; w < writers; w++)
+	{
+		WriterJob job = {sharded, tree, lock, items, n * w / writers, n * (w + 1) / writers};
+		jobs[w] = job;
+		if(pthread_create(&threads[w], NULL, runWriter, &jobs[w]) != 0)
+		{
+			fprintf(stderr, "cannot create a thread\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	for(unsigned w = 0; w < writers; w++)
+	{
+		pthread_join(threads[w], NULL);
+	}
+	return (double) n / (benchSeconds() - start) / MILLION;
+}
+
+/**
+ * insert throughput of 1 to 32 writers inserting disjoint keys: an RBTree behind a global lock,
+ * a ShardedRBTree with NUM_SHARDS shards, and parallelInsertBatch over one shard per writer.
+ * usage: bench_sharded [number of keys]
+ */
+int main(int argc, char *argv[])
+{
+	long unsigned n = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_ITEMS;
+	if(n < MAX_WRITERS * NUM_SHARDS)
+	{
+		n = MAX_WRITERS * NUM_SHARDS;
+	}
+	printf("%lu keys, Minserts/s\n", n);
+	printf("%8s %12s %12s %12s %10s\n", "writers", "global lock", "sharded", "batch", "speedup");
+	double base = 0;
+	for(unsigned writers = 1; writers <= MAX_WRITERS; writers *= 2)
+	{
+		srand(writers);
+		int** items = makeKeys(n, writers);
+		if(items == NULL)
+		{
+			fprintf(stderr, "out of memory\n");
+			return EXIT_FAILURE;
+		}
+		// the global lock and the sharded tree do not own the keys, the batch tree frees them.
+		pthread_mutex_t lock;
+		pthread_mutex_init(&lock, NULL);
+		RBTree* tree = newRBTree(compareInts, NULL);
+		double global = timeWriters(NULL, tree, &lock, items, n, writers);
+		freeRBTree(&tree);
+		pthread_mutex_destroy(&lock);
+
+		ShardedRBTree* sharded = newShardedRBTreeFromSample(compareInts, NULL, (const void *const *) items, n,
+															NUM_SHARDS);
+		double shardedRate = timeWriters(sharded, NULL, NULL, items, n, writers);
+		freeShardedRBTree(&sharded);
+
+		ShardedRBTree* batchTree = newShardedRBTreeFromSample(compareInts, free, (const void *const *) items, n,
+															  (int) writers);
+		double start = benchSeconds();
+		parallelInsertBatch(batchTree, (void **) items, n, NULL);
+		double batch = (double) n / (benchSeconds() - start) / MILLION;
+		freeShardedRBTree(&batchTree);
+		free(items);
+
+		if(writers == 1)
+		{
+			base = shardedRate;
+		}
+		printf("%8u %12.2f %12.2f %12.2f %9.2fx\n", writers, global, shardedRate, batch, shardedRate / base);
+	}
+	return EXIT_SUCCESS;
+}
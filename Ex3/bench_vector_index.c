@@ -0,0 +1,140 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "VectorIndex.h"
+
+#define DEFAULT_VECTORS 100000
+#define DEFAULT_THREADS 4
+#define NUM_QUERIES 200
+#define K 10
+#define MICRO 1e6
+
+/**
+ * the time since some fixed point
+ * @return the time in seconds
+ */
+double benchSeconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+}
+
+/**
+ * makes a Vector of uniform random coordinates in [0, 1)
+ * @param dimension the number of coordinates
+ * @return the Vector, NULL on failure
+ */
+Vector *randomVector(int dimension)
+{
+	Vector* vector = (Vector *) malloc(sizeof(Vector));
+	if(vector == NULL)
+	{
+		return NULL;
+	}
+	vector->len = dimension;
+	vector->vector = (double *) malloc(sizeof(double) * dimension);
+	if(vector->vector == NULL)
+	{
+		free(vector);
+		return NULL;
+	}
+	for(int i = 0; i < dimension; i++)
+	{
+		vector->vector[i] = (double) rand() / ((double) RAND_MAX + 1);
+	}
+	return vector;
+}
+
+/**
+ * times the k-NN queries on an index of one kind
+ * @param tree the tree of the Vectors
+ * @param kind the kind of the index
+ * @param numThreads the number of threads of a scan
+ * @param queries the queries
+ * @param build set to the time of the build in seconds
+ * @return the mean time of a query in microseconds, a negative number on failure
+ */
+double timeQueries(const RBTree *tree, VectorIndexKind kind, unsigned numThreads, Vector *const *queries,
+				   double *build)
+{
+	double start = benchSeconds();
+	VectorIndex* index = newVectorIndex(tree, kind, numThreads);
+	*build = benchSeconds() - start;
+	if(index == NULL)
+	{
+		return -1;
+	}
+	const Vector* neighbours[K];
+	start = benchSeconds();
+	for(int q = 0; q < NUM_QUERIES; q++)
+	{
+		if(vectorIndexNearest(index, queries[q], K, neighbours, NULL) != K)
+		{
+			freeVectorIndex(&index);
+			return -1;
+		}
+	}
+	double perQuery = (benchSeconds() - start) / NUM_QUERIES * MICRO;
+	freeVectorIndex(&index);
+	return perQuery;
+}
+
+/**
+ * k-NN query time of the VP tree against the threaded scan by the dimension of uniform random
+ * Vectors, to place VP_TREE_MAX_DIMENSION (the dimension up to which VECTOR_INDEX_AUTO picks the
+ * VP tree).
+ * usage: bench_vector_index [number of Vectors] [threads of the scan]
+ */
+int main(int argc, char *argv[])
+{
+	static const int dimensions[] = {2, 4, 6, 8, 10, 12, 16, 24, 32, 64, 128};
+	long unsigned n = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_VECTORS;
+	unsigned numThreads = argc > 2 ? (unsigned) strtoul(argv[2], NULL, 10) : DEFAULT_THREADS;
+	printf("%lu vectors, %d-NN, %u scan threads, microseconds per query (build seconds)\n", n, K, numThreads);
+	printf("%6s %20s %20s %8s %8s\n", "dim", "vp tree", "scan", "faster", "auto");
+	for(size_t d = 0; d < sizeof(dimensions) / sizeof(dimensions[0]); d++)
+	{
+		int dimension = dimensions[d];
+		srand((unsigned) dimension);
+		RBTree* tree = newRBTree(vectorCompare1By1, freeVector);
+		Vector* queries[NUM_QUERIES];
+		for(long unsigned i = 0; i < n; i++)
+		{
+			Vector* vector = randomVector(dimension);
+			if(vector == NULL || insertToRBTree(tree, vector) == 0)
+			{
+				fprintf(stderr, "cannot build the tree\n");
+				return EXIT_FAILURE;
+			}
+		}
+		for(int q = 0; q < NUM_QUERIES; q++)
+		{
+			queries[q] = randomVector(dimension);
+			if(queries[q] == NULL)
+			{
+				fprintf(stderr, "out of memory\n");
+				return EXIT_FAILURE;
+			}
+		}
+		double vpBuild = 0, scanBuild = 0;
+		double vp = timeQueries(tree, VECTOR_INDEX_VP_TREE, numThreads, queries, &vpBuild);
+		double scan = timeQueries(tree, VECTOR_INDEX_BRUTE_FORCE, numThreads, queries, &scanBuild);
+		VectorIndex* automatic = newVectorIndex(tree, VECTOR_INDEX_AUTO, numThreads);
+		if(vp < 0 || scan < 0 || automatic == NULL)
+		{
+			fprintf(stderr, "a query failed\n");
+			return EXIT_FAILURE;
+		}
+		printf("%6d %12.1f (%5.2f) %12.1f (%5.2f) %8s %8s\n", dimension, vp, vpBuild, scan, scanBuild,
+			   vp < scan ? "vp" : "scan", getVectorIndexKind(automatic) == VECTOR_INDEX_VP_TREE ? "vp" : "scan");
+		freeVectorIndex(&automatic);
+		for(int q = 0; q < NUM_QUERIES; q++)
+		{
+			freeVector(queries[q]);
+		}
+		freeRBTree(&tree);
+	}
+	return EXIT_SUCCESS;
+}